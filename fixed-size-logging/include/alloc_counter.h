@@ -0,0 +1,19 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// number of heap allocations made through the global operator new
+//
+// only counts when the program replaces operator new to bump it, which the
+// benchmark does in src/main.cpp. everywhere else it stays at zero.
+
+namespace alloc {
+
+inline std::atomic<std::uint64_t> count{0};
+
+inline std::uint64_t allocations() {
+  return count.load(std::memory_order_relaxed);
+}
+
+} // namespace alloc
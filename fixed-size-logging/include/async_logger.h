@@ -0,0 +1,229 @@
+#pragma once
+
+#include "logger4.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// lock-free multi producer front end, a dedicated thread does the file I/O
+//
+// producers reserve cells in a bounded MPMC ring (Vyukov style sequence
+// numbers). a message longer than one cell reserves a run of consecutive
+// cells with a single CAS, so records from different threads never
+// interleave. the writer thread drains records into any fixed-size logger.
+
+enum class Backpressure {
+  Block,      // spin until the writer thread frees space
+  DropNewest, // reject the message being written
+  DropOldest  // evict queued messages until the new one fits
+};
+
+template <typename T = Logger4<>> class AsyncLogger {
+private:
+  static constexpr std::size_t CELL_SIZE = 256;
+  struct alignas(64) Cell {
+    std::atomic<std::size_t> sequence;
+    std::atomic<std::uint32_t> span; // cells in the record, set on its first cell
+    std::uint32_t length;            // payload bytes in this cell
+    char data[CELL_SIZE - sizeof(std::size_t) - 2 * sizeof(std::uint32_t)];
+  };
+  static constexpr std::size_t PAYLOAD = sizeof(Cell::data);
+
+  T logger;
+  Backpressure policy;
+  std::vector<Cell> cells;
+  std::size_t mask;
+  alignas(64) std::atomic<std::size_t> enqueuePos{0};
+  alignas(64) std::atomic<std::size_t> dequeuePos{0};
+  alignas(64) std::atomic<std::size_t> dropped{0};
+  std::atomic<std::size_t> flushRequests{0};
+  std::atomic<std::size_t> flushesDone{0};
+  std::atomic<bool> stopping{false};
+  std::string record; // only touched by the writer thread
+  std::thread writer;
+
+  static std::size_t cellsFor(std::size_t dataSize) {
+    return dataSize == 0 ? 1 : (dataSize + PAYLOAD - 1) / PAYLOAD;
+  }
+
+  bool tryEnqueue(const char *src, std::size_t dataSize) {
+    std::size_t span = cellsFor(dataSize);
+    std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+      bool stale = false;
+      for (std::size_t i = 0; i < span; i++) {
+        std::size_t seq =
+            cells[(pos + i) & mask].sequence.load(std::memory_order_acquire);
+        std::intptr_t diff = static_cast<std::intptr_t>(seq - (pos + i));
+        if (diff < 0) {
+          return false; // still holds a record from the previous lap
+        }
+        if (diff > 0) {
+          stale = true; // another producer claimed it first
+          break;
+        }
+      }
+      if (stale) {
+        pos = enqueuePos.load(std::memory_order_relaxed);
+      } else if (enqueuePos.compare_exchange_weak(pos, pos + span,
+                                                  std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    for (std::size_t i = 0; i < span; i++) {
+      Cell &cell = cells[(pos + i) & mask];
+      std::size_t n = std::min(dataSize - std::min(dataSize, i * PAYLOAD), PAYLOAD);
+      std::memcpy(cell.data, src + i * PAYLOAD, n);
+      cell.length = n;
+    }
+    cells[pos & mask].span.store(span, std::memory_order_relaxed);
+    // publish the first cell last, consumers only look at record heads
+    for (std::size_t i = span; i-- > 0;) {
+      cells[(pos + i) & mask].sequence.store(pos + i + 1,
+                                             std::memory_order_release);
+    }
+    return true;
+  }
+
+  // pops the oldest record, appending it to out unless out is null
+  bool tryDequeue(std::string *out) {
+    std::size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    std::size_t span;
+    while (true) {
+      Cell &cell = cells[pos & mask];
+      std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+      std::intptr_t diff = static_cast<std::intptr_t>(seq - (pos + 1));
+      if (diff == 0) {
+        span = cell.span.load(std::memory_order_relaxed);
+        if (dequeuePos.compare_exchange_weak(pos, pos + span,
+                                             std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeuePos.load(std::memory_order_relaxed);
+      }
+    }
+    for (std::size_t i = 0; i < span; i++) {
+      Cell &cell = cells[(pos + i) & mask];
+      if (out != nullptr) {
+        out->append(cell.data, cell.length);
+      }
+      cell.sequence.store(pos + i + mask + 1, std::memory_order_release);
+    }
+    return true;
+  }
+
+  void run() {
+    int idle = 0;
+    while (true) {
+      record.clear();
+      if (tryDequeue(&record)) {
+        logger.write(record);
+        idle = 0;
+        continue;
+      }
+      std::size_t requested = flushRequests.load(std::memory_order_acquire);
+      if (requested != flushesDone.load(std::memory_order_relaxed)) {
+        // records queued between the empty dequeue above and the request
+        // must reach the file before the request is acknowledged
+        while (tryDequeue(&record)) {
+          logger.write(record);
+          record.clear();
+        }
+        logger.flush();
+        flushesDone.store(requested, std::memory_order_release);
+        continue;
+      }
+      if (stopping.load(std::memory_order_acquire)) {
+        break;
+      }
+      // back off gradually so an idle logger does not burn a core
+      if (++idle < 64) {
+        std::this_thread::yield();
+      } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+    }
+    record.clear();
+    while (tryDequeue(&record)) {
+      logger.write(record);
+      record.clear();
+    }
+  }
+
+public:
+  AsyncLogger(const std::string &filename, std::size_t maxFileSize,
+              Backpressure policy = Backpressure::Block,
+              std::size_t queueCells = 4096)
+      : logger(filename, maxFileSize), policy(policy) {
+    std::size_t capacity = 2;
+    while (capacity < queueCells) {
+      capacity <<= 1;
+    }
+    cells = std::vector<Cell>(capacity);
+    for (std::size_t i = 0; i < capacity; i++) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    mask = capacity - 1;
+    writer = std::thread(&AsyncLogger::run, this);
+  }
+  ~AsyncLogger() {
+    // producers must be finished, the writer drains what is left and the
+    // wrapped logger flushes in its own destructor
+    stopping.store(true, std::memory_order_release);
+    writer.join();
+  }
+  // returns false if the message was dropped
+  bool write(const char *data, std::size_t size) {
+    return write(std::string_view(data, size));
+  }
+  bool write(std::string_view data) {
+    if (cellsFor(data.size()) > mask + 1) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    while (!tryEnqueue(data.data(), data.size())) {
+      switch (policy) {
+      case Backpressure::Block:
+        std::this_thread::yield();
+        break;
+      case Backpressure::DropNewest:
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      case Backpressure::DropOldest:
+        if (tryDequeue(nullptr)) {
+          dropped.fetch_add(1, std::memory_order_relaxed);
+        } else {
+          std::this_thread::yield();
+        }
+        break;
+      }
+    }
+    return true;
+  }
+  // blocks until everything queued before the call has reached the file
+  void flush() {
+    std::size_t target = flushRequests.fetch_add(1, std::memory_order_acq_rel) + 1;
+    while (flushesDone.load(std::memory_order_acquire) < target) {
+      std::this_thread::yield();
+    }
+  }
+  std::size_t droppedMessages() const {
+    return dropped.load(std::memory_order_relaxed);
+  }
+  // the wrapped logger's counters plus the messages dropped at the queue
+  StatsSnapshot stats() const {
+    StatsSnapshot res = logger.stats();
+    res.dropped += droppedMessages();
+    return res;
+  }
+};
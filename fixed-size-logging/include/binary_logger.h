@@ -0,0 +1,451 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+// structured binary logging with deferred formatting
+//
+// the hot path copies a format id and the raw arguments into the buffer,
+// formatting into text happens offline in BinaryLogDecoder (see decode.cpp).
+// record layout: [varint payload size][varint format id][encoded args]
+//   bool, char   -> 1 byte
+//   signed int   -> zigzag varint, unsigned int -> varint
+//   float/double -> 4/8 raw bytes
+//   strings      -> varint length + bytes
+// format strings are written once to "<filename>.fmt". the file is capped
+// like Logger4, but only whole records are dropped so it stays decodable.
+
+namespace binlog {
+
+template <typename T> constexpr char typeCode() {
+  using U = std::decay_t<T>;
+  if constexpr (std::is_same_v<U, bool>) {
+    return 'b';
+  } else if constexpr (std::is_same_v<U, char>) {
+    return 'c';
+  } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+    return 'i';
+  } else if constexpr (std::is_integral_v<U>) {
+    return 'u';
+  } else if constexpr (std::is_same_v<U, float>) {
+    return 'f';
+  } else if constexpr (std::is_same_v<U, double>) {
+    return 'd';
+  } else {
+    static_assert(std::is_convertible_v<U, std::string_view>,
+                  "unsupported binary log argument type");
+    return 's';
+  }
+}
+
+inline std::size_t varintSize(std::uint64_t value) {
+  std::size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+inline char *putVarint(char *out, std::uint64_t value) {
+  while (value >= 0x80) {
+    *out++ = static_cast<char>(value | 0x80);
+    value >>= 7;
+  }
+  *out++ = static_cast<char>(value);
+  return out;
+}
+
+// returns nullptr if the varint runs past end
+inline const char *getVarint(const char *in, const char *end,
+                             std::uint64_t &value) {
+  value = 0;
+  for (int shift = 0; in < end && shift < 64; shift += 7) {
+    std::uint8_t byte = static_cast<std::uint8_t>(*in++);
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return in;
+    }
+  }
+  return nullptr;
+}
+
+inline std::uint64_t zigzag(std::int64_t value) {
+  return (static_cast<std::uint64_t>(value) << 1) ^
+         static_cast<std::uint64_t>(value >> 63);
+}
+
+inline std::int64_t unzigzag(std::uint64_t value) {
+  return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+template <typename T> std::size_t encodedSize(const T &arg) {
+  constexpr char code = typeCode<T>();
+  if constexpr (code == 'b' || code == 'c') {
+    return 1;
+  } else if constexpr (code == 'i') {
+    return varintSize(zigzag(arg));
+  } else if constexpr (code == 'u') {
+    return varintSize(arg);
+  } else if constexpr (code == 'f' || code == 'd') {
+    return sizeof(T);
+  } else {
+    std::string_view view(arg);
+    return varintSize(view.size()) + view.size();
+  }
+}
+
+template <typename T> char *encode(char *out, const T &arg) {
+  constexpr char code = typeCode<T>();
+  if constexpr (code == 'b' || code == 'c') {
+    *out++ = static_cast<char>(arg);
+  } else if constexpr (code == 'i') {
+    out = putVarint(out, zigzag(arg));
+  } else if constexpr (code == 'u') {
+    out = putVarint(out, arg);
+  } else if constexpr (code == 'f' || code == 'd') {
+    std::memcpy(out, &arg, sizeof(T));
+    out += sizeof(T);
+  } else {
+    std::string_view view(arg);
+    out = putVarint(out, view.size());
+    std::memcpy(out, view.data(), view.size());
+    out += view.size();
+  }
+  return out;
+}
+
+// keeps log() arguments from taking part in template deduction
+template <typename T> struct Identity {
+  using type = T;
+};
+
+} // namespace binlog
+
+// a registered format string, the argument types are part of the handle so
+// log() cannot be called with arguments the decoder would misread
+template <typename... Args> struct BinaryFormat {
+  std::uint16_t id;
+};
+
+class BinaryLogger {
+private:
+  struct FormatEntry {
+    std::string format;
+    std::string types;
+  };
+  static std::mutex &registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+  static std::vector<FormatEntry> &registry() {
+    static std::vector<FormatEntry> formats;
+    return formats;
+  }
+
+  const int BUFFER_SIZE = 8 * 1024; // 8KB buffer size
+  std::string filename;
+  int fd = -1;
+  std::size_t maxFileSize;
+  std::size_t fileSize = 0;
+  std::vector<char> buffer;
+  std::size_t bufferSize = 0;
+  std::vector<char> temp;
+  std::ofstream dictionary;
+  std::size_t formatsWritten = 0;
+
+  static std::size_t recordSize(const char *record, const char *end) {
+    std::uint64_t payload;
+    const char *body = binlog::getVarint(record, end, payload);
+    if (body == nullptr || payload > static_cast<std::size_t>(end - body)) {
+      throw std::runtime_error("BinaryLogger: corrupt record");
+    }
+    return (body - record) + payload;
+  }
+
+  void writeDictionary() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    std::vector<FormatEntry> &formats = registry();
+    char header[3 * 10];
+    for (; formatsWritten < formats.size(); formatsWritten++) {
+      const FormatEntry &entry = formats[formatsWritten];
+      char *out = binlog::putVarint(header, formatsWritten);
+      out = binlog::putVarint(out, entry.types.size());
+      dictionary.write(header, out - header);
+      dictionary.write(entry.types.data(), entry.types.size());
+      out = binlog::putVarint(header, entry.format.size());
+      dictionary.write(header, out - header);
+      dictionary.write(entry.format.data(), entry.format.size());
+    }
+    dictionary.flush();
+  }
+
+  // writes whole records to the file, dropping the oldest records once the
+  // cap is reached
+  void append(const char *data, std::size_t dataSize) {
+    const char *dataEnd = data + dataSize;
+    while (dataSize > maxFileSize) {
+      std::size_t skip = recordSize(data, dataEnd);
+      data += skip;
+      dataSize -= skip;
+    }
+    if (dataSize == 0) {
+      return;
+    }
+    bool shrunk = false;
+    if (fileSize + dataSize > maxFileSize) {
+      std::size_t bytesToRemove = fileSize + dataSize - maxFileSize;
+      if (::pread(fd, temp.data(), fileSize, 0) !=
+          static_cast<ssize_t>(fileSize)) {
+        throw std::runtime_error("BinaryLogger: cannot read file: " + filename);
+      }
+      std::size_t offset = 0;
+      while (offset < bytesToRemove) {
+        offset += recordSize(temp.data() + offset, temp.data() + fileSize);
+      }
+      std::size_t oldDataSize = fileSize - offset;
+      if (::pwrite(fd, temp.data() + offset, oldDataSize, 0) !=
+          static_cast<ssize_t>(oldDataSize)) {
+        throw std::runtime_error("BinaryLogger: write failed: " + filename);
+      }
+      fileSize = oldDataSize;
+      shrunk = true;
+    }
+    if (::pwrite(fd, data, dataSize, fileSize) != static_cast<ssize_t>(dataSize)) {
+      throw std::runtime_error("BinaryLogger: write failed: " + filename);
+    }
+    fileSize += dataSize;
+    if (shrunk && ::ftruncate(fd, fileSize) != 0) {
+      throw std::runtime_error("BinaryLogger: truncate failed: " + filename);
+    }
+  }
+
+public:
+  BinaryLogger(const std::string &filename, std::size_t maxFileSize) {
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Constructor: cannot open file: " + filename);
+    }
+    dictionary.open(filename + ".fmt", std::ios::binary | std::ios::trunc);
+    if (!dictionary) {
+      ::close(fd);
+      throw std::runtime_error("Constructor: cannot open file: " + filename +
+                               ".fmt");
+    }
+    this->filename = filename;
+    this->maxFileSize = maxFileSize;
+    buffer.resize(BUFFER_SIZE);
+    temp.resize(maxFileSize);
+  }
+  ~BinaryLogger() {
+    if (fd >= 0) {
+      try {
+        flush();
+      } catch (const std::exception &) {
+        // nothing left to report the error to
+      }
+      ::close(fd);
+    }
+  }
+
+  // ids are process wide and stable for the lifetime of the process
+  template <typename... Args>
+  static BinaryFormat<std::decay_t<Args>...> registerFormat(const char *format) {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    std::vector<FormatEntry> &formats = registry();
+    if (formats.size() > UINT16_MAX) {
+      throw std::runtime_error("BinaryLogger: too many formats");
+    }
+    formats.push_back({format, std::string{binlog::typeCode<Args>()...}});
+    return {static_cast<std::uint16_t>(formats.size() - 1)};
+  }
+
+  template <typename... Args>
+  void log(BinaryFormat<Args...> format,
+           const typename binlog::Identity<Args>::type &...args) {
+    std::size_t payload = binlog::varintSize(format.id) +
+                          (binlog::encodedSize<Args>(args) + ... + 0);
+    std::size_t size = binlog::varintSize(payload) + payload;
+    if (static_cast<int>(bufferSize + size) > BUFFER_SIZE) {
+      flush();
+    }
+    if (static_cast<int>(size) > BUFFER_SIZE) {
+      // too big to batch, only happens for very long string arguments
+      std::vector<char> record(size);
+      char *out = binlog::putVarint(record.data(), payload);
+      out = binlog::putVarint(out, format.id);
+      ((out = binlog::encode<Args>(out, args)), ...);
+      append(record.data(), size);
+      return;
+    }
+    char *out = binlog::putVarint(buffer.data() + bufferSize, payload);
+    out = binlog::putVarint(out, format.id);
+    ((out = binlog::encode<Args>(out, args)), ...);
+    bufferSize += size;
+  }
+
+  void flush() {
+    writeDictionary();
+    append(buffer.data(), bufferSize);
+    bufferSize = 0;
+  }
+};
+
+// registers the format once per call site, then logs
+#define BINLOG(logger, format, ...)                                            \
+  [&](const auto &...binlogArgs) {                                             \
+    static const auto binlogFormat =                                           \
+        BinaryLogger::registerFormat<decltype(binlogArgs)...>(format);         \
+    (logger).log(binlogFormat, binlogArgs...);                                 \
+  }(__VA_ARGS__)
+
+// turns a binary log and its format dictionary back into text, each "{}" in
+// a format string is replaced by the next argument
+class BinaryLogDecoder {
+private:
+  struct FormatEntry {
+    std::string format;
+    std::string types;
+  };
+  std::vector<FormatEntry> formats;
+  std::string data;
+  std::size_t ptr = 0;
+
+  static std::string readFile(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Decoder: cannot open file: " + path);
+    }
+    return std::string((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+  }
+
+  static const char *need(const char *in) {
+    if (in == nullptr) {
+      throw std::runtime_error("Decoder: truncated record");
+    }
+    return in;
+  }
+
+  template <typename T> static void appendNumber(std::string &out, T value) {
+    char text[32];
+    std::to_chars_result res = std::to_chars(text, text + sizeof(text), value);
+    out.append(text, res.ptr - text);
+  }
+
+  // decodes one argument of the given type code and appends it as text
+  static const char *decodeArg(char code, const char *in, const char *end,
+                               std::string &out) {
+    std::uint64_t value;
+    switch (code) {
+    case 'b':
+      need(in < end ? in : nullptr);
+      out += *in ? "true" : "false";
+      return in + 1;
+    case 'c':
+      need(in < end ? in : nullptr);
+      out += *in;
+      return in + 1;
+    case 'i':
+      in = need(binlog::getVarint(in, end, value));
+      appendNumber(out, binlog::unzigzag(value));
+      return in;
+    case 'u':
+      in = need(binlog::getVarint(in, end, value));
+      appendNumber(out, value);
+      return in;
+    case 'f': {
+      float f;
+      need(end - in >= static_cast<std::ptrdiff_t>(sizeof(f)) ? in : nullptr);
+      std::memcpy(&f, in, sizeof(f));
+      appendNumber(out, f);
+      return in + sizeof(f);
+    }
+    case 'd': {
+      double d;
+      need(end - in >= static_cast<std::ptrdiff_t>(sizeof(d)) ? in : nullptr);
+      std::memcpy(&d, in, sizeof(d));
+      appendNumber(out, d);
+      return in + sizeof(d);
+    }
+    case 's':
+      in = need(binlog::getVarint(in, end, value));
+      need(value <= static_cast<std::uint64_t>(end - in) ? in : nullptr);
+      out.append(in, value);
+      return in + value;
+    default:
+      throw std::runtime_error("Decoder: unknown argument type");
+    }
+  }
+
+public:
+  BinaryLogDecoder(const std::string &filename) {
+    std::string dict = readFile(filename + ".fmt");
+    const char *in = dict.data();
+    const char *end = in + dict.size();
+    while (in < end) {
+      std::uint64_t id, typesSize, formatSize;
+      in = need(binlog::getVarint(in, end, id));
+      in = need(binlog::getVarint(in, end, typesSize));
+      need(typesSize <= static_cast<std::uint64_t>(end - in) ? in : nullptr);
+      std::string types(in, typesSize);
+      in = need(binlog::getVarint(in + typesSize, end, formatSize));
+      need(formatSize <= static_cast<std::uint64_t>(end - in) ? in : nullptr);
+      if (id >= formats.size()) {
+        formats.resize(id + 1);
+      }
+      formats[id] = {std::string(in, formatSize), types};
+      in += formatSize;
+    }
+    data = readFile(filename);
+  }
+
+  // appends the next record as text, returns false at the end of the log
+  bool next(std::string &out) {
+    if (ptr >= data.size()) {
+      return false;
+    }
+    const char *in = data.data() + ptr;
+    const char *end = data.data() + data.size();
+    std::uint64_t payload, id;
+    const char *body = need(binlog::getVarint(in, end, payload));
+    need(payload <= static_cast<std::uint64_t>(end - body) ? body : nullptr);
+    const char *recordEnd = body + payload;
+    body = need(binlog::getVarint(body, recordEnd, id));
+    if (id >= formats.size()) {
+      throw std::runtime_error("Decoder: unknown format id");
+    }
+    const FormatEntry &entry = formats[id];
+    std::size_t arg = 0;
+    const std::string &format = entry.format;
+    for (std::size_t i = 0; i < format.size(); i++) {
+      if (format[i] == '{' && i + 1 < format.size() && format[i + 1] == '}' &&
+          arg < entry.types.size()) {
+        body = decodeArg(entry.types[arg++], body, recordEnd, out);
+        i++;
+      } else {
+        out += format[i];
+      }
+    }
+    ptr = recordEnd - data.data();
+    return true;
+  }
+
+  std::string decode() {
+    std::string res;
+    while (next(res)) {
+    }
+    return res;
+  }
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+// HDR style latency histogram, log-linear buckets with ~3% precision
+//
+// values below SUB_BUCKETS get their own bucket, above that every power of
+// two is split into SUB_BUCKETS / 2 linear buckets. recording is a couple of
+// shifts and an increment so it can sit on a hot path.
+
+class LatencyHistogram {
+private:
+  static constexpr int SUB_BITS = 5;
+  static constexpr std::uint64_t SUB_BUCKETS = 1 << SUB_BITS;
+  static constexpr std::uint64_t HALF = SUB_BUCKETS / 2;
+
+public:
+  static constexpr std::size_t BUCKETS = (64 - SUB_BITS + 1) * HALF + HALF;
+
+  static std::size_t indexOf(std::uint64_t value) {
+    if (value < SUB_BUCKETS) {
+      return value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - (SUB_BITS - 1);
+    return (shift + 1) * HALF + ((value >> shift) - HALF);
+  }
+
+  // largest value that lands in the bucket
+  static std::uint64_t valueOf(std::size_t index) {
+    if (index < SUB_BUCKETS) {
+      return index;
+    }
+    int shift = index / HALF - 1;
+    std::uint64_t sub = index % HALF + HALF;
+    return ((sub + 1) << shift) - 1;
+  }
+
+private:
+  std::array<std::uint64_t, BUCKETS> counts{};
+  std::uint64_t total = 0;
+  std::uint64_t maxValue = 0;
+  std::uint64_t sum = 0;
+
+public:
+  void record(std::uint64_t value) {
+    counts[indexOf(value)]++;
+    total++;
+    sum += value;
+    maxValue = std::max(maxValue, value);
+  }
+  void merge(const LatencyHistogram &other) {
+    for (std::size_t i = 0; i < BUCKETS; i++) {
+      counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    maxValue = std::max(maxValue, other.maxValue);
+  }
+  // bulk insert for histograms whose buckets are kept elsewhere (see stats.h)
+  void addBucket(std::size_t index, std::uint64_t n) {
+    counts[index] += n;
+    total += n;
+  }
+  void addTotals(std::uint64_t valueSum, std::uint64_t valueMax) {
+    sum += valueSum;
+    maxValue = std::max(maxValue, valueMax);
+  }
+  void reset() { *this = LatencyHistogram(); }
+  std::uint64_t count() const { return total; }
+  std::uint64_t max() const { return maxValue; }
+  double mean() const { return total == 0 ? 0.0 : double(sum) / total; }
+  // p in [0, 100]
+  std::uint64_t percentile(double p) const {
+    if (total == 0) {
+      return 0;
+    }
+    std::uint64_t rank = static_cast<std::uint64_t>(p / 100.0 * total + 0.5);
+    rank = std::clamp<std::uint64_t>(rank, 1, total);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < BUCKETS; i++) {
+      seen += counts[i];
+      if (seen >= rank) {
+        return std::min(valueOf(i), maxValue);
+      }
+    }
+    return maxValue;
+  }
+};
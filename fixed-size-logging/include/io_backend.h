@@ -0,0 +1,244 @@
+#pragma once
+
+#include <aio.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+// pluggable file backends for the fixed-size loggers
+//
+// every backend has the same interface:
+//   open(filename)         create/truncate the file
+//   read(dst, n, offset)   synchronous read, waits for the write in flight
+//   submit(src, n, offset) start a write, src must stay untouched until the
+//                          next submit/read/wait returns
+//   wait()                 block until the write in flight is done
+//   close(fileSize)        wait and close, fileSize is the logical size
+// at most one write is in flight at a time. writes always end at the
+// logical end of the file, which lets the O_DIRECT backend pad the last
+// block freely.
+
+// heap buffer with a start address aligned for O_DIRECT
+class AlignedBuffer {
+private:
+  char *ptr = nullptr;
+  std::size_t bytes = 0;
+
+public:
+  AlignedBuffer() = default;
+  AlignedBuffer(std::size_t size, std::size_t alignment) {
+    resize(size, alignment);
+  }
+  AlignedBuffer(const AlignedBuffer &) = delete;
+  AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+  ~AlignedBuffer() { std::free(ptr); }
+  void resize(std::size_t size, std::size_t alignment) {
+    std::free(ptr);
+    // aligned_alloc wants a size that is a multiple of the alignment
+    bytes = (std::max<std::size_t>(size, 1) + alignment - 1) / alignment * alignment;
+    ptr = static_cast<char *>(std::aligned_alloc(alignment, bytes));
+    if (ptr == nullptr) {
+      throw std::bad_alloc();
+    }
+  }
+  char *data() { return ptr; }
+  std::size_t size() const { return bytes; }
+};
+
+// the blocking std::fstream path Logger4 uses, kept as the baseline
+class FstreamBackend {
+private:
+  std::fstream file;
+
+public:
+  static constexpr const char *NAME = "fstream";
+
+  void open(const std::string &filename) {
+    file.open(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+    file.close();
+    file.open(filename, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file) {
+      throw std::runtime_error("Constructor: cannot open file: " + filename);
+    }
+  }
+  void read(char *dst, std::size_t n, std::size_t offset) {
+    file.seekg(offset, std::ios::beg);
+    file.read(dst, n);
+  }
+  void submit(const char *src, std::size_t n, std::size_t offset) {
+    file.seekp(offset, std::ios::beg);
+    file.write(src, n);
+  }
+  void wait() {}
+  void close(std::size_t) {
+    if (file.is_open()) {
+      file.close();
+    }
+  }
+};
+
+// POSIX AIO, the write runs on glibc's helper thread while the caller keeps
+// filling its next buffer. with Direct the file is opened O_DIRECT to keep
+// log data out of the page cache; writes are staged into block aligned
+// buffers and the last partial block is kept in memory so appends at
+// unaligned offsets do not need a read-modify-write.
+template <bool Direct = false> class PosixAioBackend {
+private:
+  static constexpr std::size_t BLOCK = 4096;
+
+  std::string filename;
+  int fd = -1;
+  bool direct = Direct;
+  bool inFlight = false;
+  struct aiocb cb;
+  AlignedBuffer staging;
+  AlignedBuffer scratch;
+  AlignedBuffer tail; // copy of the last partial block that was written
+  std::size_t tailOffset = 0;
+  bool tailValid = false;
+
+  void fail(const std::string &what) {
+    throw std::runtime_error("PosixAioBackend: " + what + ": " + filename +
+                             ": " + std::strerror(errno));
+  }
+
+  static std::size_t alignUp(std::size_t n) {
+    return (n + BLOCK - 1) / BLOCK * BLOCK;
+  }
+
+public:
+  static constexpr const char *NAME = Direct ? "aio + O_DIRECT" : "aio";
+
+  PosixAioBackend() = default;
+  PosixAioBackend(const PosixAioBackend &) = delete;
+  PosixAioBackend &operator=(const PosixAioBackend &) = delete;
+  ~PosixAioBackend() {
+    if (fd >= 0) {
+      try {
+        wait();
+      } catch (const std::exception &) {
+        // nothing left to report the error to
+      }
+      ::close(fd);
+    }
+  }
+
+  void open(const std::string &filename) {
+    this->filename = filename;
+    int flags = O_RDWR | O_CREAT | O_TRUNC;
+    if (direct) {
+      fd = ::open(filename.c_str(), flags | O_DIRECT, 0644);
+      if (fd < 0 && errno == EINVAL) {
+        direct = false; // filesystem without O_DIRECT support, e.g. tmpfs
+      }
+    }
+    if (fd < 0) {
+      fd = ::open(filename.c_str(), flags, 0644);
+    }
+    if (fd < 0) {
+      throw std::runtime_error("Constructor: cannot open file: " + filename);
+    }
+    if (direct) {
+      tail.resize(BLOCK, BLOCK);
+    }
+  }
+
+  void wait() {
+    if (!inFlight) {
+      return;
+    }
+    const struct aiocb *list[1] = {&cb};
+    int err;
+    while ((err = ::aio_error(&cb)) == EINPROGRESS) {
+      ::aio_suspend(list, 1, nullptr);
+    }
+    inFlight = false;
+    if (err != 0 || ::aio_return(&cb) != static_cast<ssize_t>(cb.aio_nbytes)) {
+      errno = err;
+      fail("write failed");
+    }
+  }
+
+  void read(char *dst, std::size_t n, std::size_t offset) {
+    wait();
+    if (n == 0) {
+      return;
+    }
+    if (!direct) {
+      if (::pread(fd, dst, n, offset) != static_cast<ssize_t>(n)) {
+        fail("read failed");
+      }
+      return;
+    }
+    std::size_t start = offset / BLOCK * BLOCK;
+    std::size_t length = alignUp(offset + n) - start;
+    if (scratch.size() < length) {
+      scratch.resize(length, BLOCK);
+    }
+    if (::pread(fd, scratch.data(), length, start) <
+        static_cast<ssize_t>(offset + n - start)) {
+      fail("read failed");
+    }
+    std::memcpy(dst, scratch.data() + (offset - start), n);
+  }
+
+  void submit(const char *src, std::size_t n, std::size_t offset) {
+    wait();
+    std::memset(&cb, 0, sizeof(cb));
+    cb.aio_fildes = fd;
+    if (!direct) {
+      cb.aio_buf = const_cast<char *>(src);
+      cb.aio_nbytes = n;
+      cb.aio_offset = offset;
+    } else {
+      std::size_t start = offset / BLOCK * BLOCK;
+      std::size_t head = offset - start;
+      std::size_t length = alignUp(head + n);
+      if (staging.size() < length) {
+        staging.resize(length, BLOCK);
+      }
+      if (head > 0) {
+        if (tailValid && tailOffset == start) {
+          std::memcpy(staging.data(), tail.data(), head);
+        } else {
+          read(staging.data(), head, start);
+        }
+      }
+      std::memcpy(staging.data() + head, src, n);
+      std::memset(staging.data() + head + n, 0, length - head - n);
+      std::size_t full = (head + n) / BLOCK * BLOCK;
+      tailValid = full < head + n;
+      if (tailValid) {
+        std::memcpy(tail.data(), staging.data() + full, BLOCK);
+        tailOffset = start + full;
+      }
+      cb.aio_buf = staging.data();
+      cb.aio_nbytes = length;
+      cb.aio_offset = start;
+    }
+    if (::aio_write(&cb) != 0) {
+      fail("cannot submit write");
+    }
+    inFlight = true;
+  }
+
+  void close(std::size_t fileSize) {
+    if (fd < 0) {
+      return;
+    }
+    wait();
+    // O_DIRECT writes whole blocks, cut the padding off again
+    if (direct && ::ftruncate(fd, fileSize) != 0) {
+      fail("cannot truncate");
+    }
+    ::close(fd);
+    fd = -1;
+  }
+};
@@ -0,0 +1,256 @@
+#pragma once
+
+#include "seek_index.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <immintrin.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// reads a log written by Logger4<..., SeekIndex<>> without scanning it
+//
+// the log is mapped, tail() walks back from the end, range() and since()
+// jump to the index entries around the requested times and search() only
+// looks at the region it is given. range granularity is one index
+// interval: the result holds every record written in [from, to] plus at
+// most an interval of records on either side. without an index file only
+// tail() and search() over the whole text are useful.
+
+namespace logsearch {
+
+inline bool hasAvx2() {
+  static const bool avx2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  }();
+  return avx2;
+}
+
+inline std::size_t findScalar(std::string_view text, std::string_view needle, std::size_t from) {
+  const char *p = text.data() + from;
+  const char *last = text.data() + text.size() - needle.size() + 1;
+  while (p < last &&
+         (p = static_cast<const char *>(std::memchr(p, needle[0], last - p))) != nullptr) {
+    if (std::memcmp(p + 1, needle.data() + 1, needle.size() - 1) == 0) {
+      return p - text.data();
+    }
+    p++;
+  }
+  return std::string_view::npos;
+}
+
+// compares the first and last needle byte 32 positions at a time and only
+// memcmps where both match (Mula's generic SIMD substring search)
+__attribute__((target("avx2"))) inline std::size_t
+findAvx2(std::string_view text, std::string_view needle, std::size_t from) {
+  std::size_t k = needle.size();
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[k - 1]);
+  std::size_t i = from;
+  for (; i + k - 1 + 32 <= text.size(); i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text.data() + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text.data() + i + k - 1));
+    auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+    while (mask != 0) {
+      std::size_t at = i + __builtin_ctz(mask);
+      if (std::memcmp(text.data() + at + 1, needle.data() + 1, k - 2) == 0) {
+        return at;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return findScalar(text, needle, i);
+}
+
+// first occurrence of needle in text at or after from, npos if none
+inline std::size_t find(std::string_view text, std::string_view needle, std::size_t from = 0) {
+  if (needle.empty()) {
+    return from <= text.size() ? from : std::string_view::npos;
+  }
+  if (from > text.size() || text.size() - from < needle.size()) {
+    return std::string_view::npos;
+  }
+  if (needle.size() >= 2 && hasAvx2()) {
+    return findAvx2(text, needle, from);
+  }
+  return findScalar(text, needle, from);
+}
+
+} // namespace logsearch
+
+// read-only mapping of the whole log, tail() and range() only touch the
+// pages they return
+class MappedLog {
+private:
+  const char *ptr = nullptr;
+  std::size_t length = 0;
+
+public:
+  explicit MappedLog(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("MappedLog: cannot open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw std::runtime_error("MappedLog: cannot stat " + path);
+    }
+    length = st.st_size;
+    if (length > 0) {
+      void *p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("MappedLog: cannot map " + path);
+      }
+      ptr = static_cast<const char *>(p);
+    }
+    ::close(fd);
+  }
+  MappedLog(const MappedLog &) = delete;
+  MappedLog &operator=(const MappedLog &) = delete;
+  ~MappedLog() {
+    if (ptr != nullptr) {
+      ::munmap(const_cast<char *>(ptr), length);
+    }
+  }
+  std::string_view view() const { return {ptr == nullptr ? "" : ptr, length}; }
+};
+
+class LogReader {
+private:
+  MappedLog log;
+  std::uint64_t base = 0;
+  std::uint64_t interval = 0;
+  std::vector<SeekEntry> entries; // only those that start a record in the mapped log
+  std::size_t start = 0;          // the first whole record
+
+  // entries that aged out, point past the end of a log flushed after the
+  // index was read, or were caught mid rewrite are dropped
+  void loadIndex(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    std::vector<char> bytes;
+    char chunk[1 << 16];
+    ssize_t n;
+    while ((n = ::read(fd, chunk, sizeof(chunk))) > 0) {
+      bytes.insert(bytes.end(), chunk, chunk + n);
+    }
+    ::close(fd);
+    SeekIndexHeader header;
+    if (bytes.size() < sizeof(header)) {
+      return;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != SEEK_INDEX_MAGIC) {
+      throw std::runtime_error("LogReader: not a seek index: " + path);
+    }
+    base = header.base;
+    interval = header.interval;
+    std::string_view text = log.view();
+    for (std::size_t i = sizeof(header); i + sizeof(SeekEntry) <= bytes.size(); i += sizeof(SeekEntry)) {
+      SeekEntry e;
+      std::memcpy(&e, bytes.data() + i, sizeof(e));
+      if (e.offset < base || e.offset - base >= text.size() ||
+          (!entries.empty() && e.offset <= entries.back().offset)) {
+        continue;
+      }
+      if (e.offset > base && text[e.offset - base - 1] != '\n') {
+        continue;
+      }
+      entries.push_back(e);
+    }
+    // the compaction cut the front of the log anywhere in a record
+    if (base > 0 && (entries.empty() || entries.front().offset != base)) {
+      const void *nl = std::memchr(text.data(), '\n', text.size());
+      start = nl == nullptr ? text.size() : static_cast<const char *>(nl) - text.data() + 1;
+    }
+  }
+
+  std::size_t at(const SeekEntry &e) const { return e.offset - base; }
+
+public:
+  explicit LogReader(const std::string &path) : log(path) { loadIndex(seekIndexName(path)); }
+
+  // every whole record in the log
+  std::string_view text() const { return log.view().substr(start); }
+
+  const std::vector<SeekEntry> &index() const { return entries; }
+  std::uint64_t indexInterval() const { return interval; }
+
+  // the last n records
+  std::string_view tail(std::size_t n) const {
+    std::string_view all = text();
+    std::size_t end = all.size();
+    if (end > 0 && all[end - 1] == '\n') {
+      end--;
+    }
+    std::size_t from = end;
+    for (std::size_t i = 0; i < n; i++) {
+      const void *nl = ::memrchr(all.data(), '\n', from);
+      if (nl == nullptr) {
+        return all;
+      }
+      from = static_cast<const char *>(nl) - all.data();
+    }
+    return n == 0 ? all.substr(all.size()) : all.substr(from + 1);
+  }
+
+  // records written between fromNs and toNs (system_clock since epoch),
+  // give or take an index interval
+  std::string_view range(std::int64_t fromNs, std::int64_t toNs) const {
+    std::string_view all = log.view();
+    if (entries.empty()) {
+      return text();
+    }
+    auto byTime = [](const SeekEntry &e, std::int64_t t) { return e.timeNs < t; };
+    auto first = std::lower_bound(entries.begin(), entries.end(), fromNs, byTime);
+    std::size_t begin = first == entries.begin() ? start : at(*(first - 1));
+    auto last = std::upper_bound(entries.begin(), entries.end(), toNs,
+                                 [](std::int64_t t, const SeekEntry &e) { return t < e.timeNs; });
+    std::size_t end = last == entries.end() ? all.size() : at(*last);
+    return begin < end ? all.substr(begin, end - begin) : all.substr(all.size());
+  }
+
+  // records written in the last age
+  std::string_view since(std::chrono::nanoseconds age) const {
+    std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
+    return range(now - age.count(), INT64_MAX);
+  }
+
+  // calls onLine with every record in region (a part of text(), range() or
+  // tail()) that contains needle, returns how many there were
+  template <typename F>
+  std::size_t search(std::string_view needle, F &&onLine, std::string_view region) const {
+    std::size_t matches = 0;
+    std::size_t pos = 0;
+    while ((pos = logsearch::find(region, needle, pos)) != std::string_view::npos &&
+           pos < region.size()) {
+      const void *nl = pos == 0 ? nullptr : ::memrchr(region.data(), '\n', pos);
+      std::size_t lineStart = nl == nullptr ? 0 : static_cast<const char *>(nl) - region.data() + 1;
+      const void *eol = std::memchr(region.data() + pos, '\n', region.size() - pos);
+      std::size_t lineEnd = eol == nullptr ? region.size() : static_cast<const char *>(eol) - region.data();
+      onLine(region.substr(lineStart, lineEnd - lineStart));
+      matches++;
+      pos = lineEnd + 1;
+    }
+    return matches;
+  }
+  template <typename F> std::size_t search(std::string_view needle, F &&onLine) const {
+    return search(needle, std::forward<F>(onLine), text());
+  }
+};
@@ -3,6 +3,7 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // naive implementation for fixed size logging
@@ -30,7 +31,10 @@ public:
       file.close();
     }
   }
-  void write(const std::string &data) {
+  void write(const char *data, std::size_t size) {
+    write(std::string_view(data, size));
+  }
+  void write(std::string_view data) {
     // get size of data and file
     std::size_t dataSize = data.size();
     std::size_t currentSize = file.tellg();
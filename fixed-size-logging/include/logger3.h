@@ -2,6 +2,7 @@
 
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // reducing flushes from buffered implementation
@@ -23,6 +24,7 @@ public:
     }
     this->filename = filename;
     this->maxFileSize = maxFileSize;
+    buffer.reserve(BUFFER_SIZE); // insert never reallocates below the cap
   }
   ~Logger3() {
     if (file.is_open()) {
@@ -30,7 +32,10 @@ public:
       file.close();
     }
   }
-  void write(const std::string &data) {
+  void write(const char *data, std::size_t size) {
+    write(std::string_view(data, size));
+  }
+  void write(std::string_view data) {
     std::size_t dataSize = data.size();
     // check if buffer is full
     if (static_cast<int>(buffer.size() + dataSize) > BUFFER_SIZE) {
@@ -1,13 +1,18 @@
 #pragma once
 
+#include "seek_index.h"
+#include "stats.h"
 #include <cstring>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // additional performance boosts
+// Stats = LoggerStats turns on the hot path counters, see stats.h
+// Index = SeekIndex<> keeps a sparse seek index next to the log, see seek_index.h
 
-class Logger4 {
+template <typename Stats = NoStats, typename Index = NoSeekIndex> class Logger4 {
 private:
   const int BUFFER_SIZE = 8 * 1024; // 8KB buffer size
   std::string filename;
@@ -16,8 +21,10 @@ private:
   std::vector<char> buffer;
   std::size_t bufferSize;
   std::vector<char> temp;
+  Stats counters;
+  Index index;
 public:
-  Logger4(const std::string &filename, std::size_t maxFileSize) {
+  Logger4(const std::string &filename, std::size_t maxFileSize) : index(filename) {
     file.open(filename, std::ios::binary | std::ios::out | std::ios::trunc);
     file.close();
     file.open(filename, std::ios::binary | std::ios::in | std::ios::out);
@@ -36,16 +43,25 @@ public:
       file.close();
     }
   }
-  void write(const std::string &data) {
+  void write(const char *data, std::size_t size) {
+    write(std::string_view(data, size));
+  }
+  void write(std::string_view data) {
     std::size_t dataSize = data.size();
+    counters.recordWrite(dataSize);
     if (static_cast<int>(bufferSize + dataSize) > BUFFER_SIZE) {
       flush();
     }
+    if (bufferSize == 0) {
+      index.recordStart();
+    }
     std::memcpy(buffer.data() + bufferSize, data.data(), dataSize);
     bufferSize += dataSize;
   }
   void flush() {
+    typename Stats::FlushTimer timer(counters);
     int currFileSize = file.tellg();
+    std::size_t removed = 0;
     if (bufferSize + currFileSize > maxFileSize) {
       int bytesToRemove = bufferSize + currFileSize - maxFileSize;
       int oldDataSize = currFileSize - bytesToRemove;
@@ -53,8 +69,13 @@ public:
       file.read(temp.data(), oldDataSize);
       file.seekp(0, std::ios::beg);
       file.write(temp.data(), oldDataSize);
+      counters.recordWrap(oldDataSize);
+      counters.recordDrop(bytesToRemove);
+      removed = bytesToRemove;
     }
     file.write(buffer.data(), bufferSize);
+    index.flushed(buffer.data(), bufferSize, removed);
     bufferSize = 0;
   }
+  StatsSnapshot stats() const { return counters.snapshot(); }
 };
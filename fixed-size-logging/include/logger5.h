@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// memory mapped circular buffer, wrapping costs nothing extra
+//
+// file layout: [Header][capacity bytes of ring data]
+// begin/end are logical byte counts, the physical offset of a logical
+// position is (position % capacity) so the ring never has to be shifted
+
+class Logger5 {
+private:
+  struct Header {
+    char magic[8];
+    std::uint64_t capacity;
+    std::uint64_t begin; // logical offset of the oldest retained byte
+    std::uint64_t end;   // logical offset one past the newest byte
+    char padding[32];
+  };
+  static_assert(sizeof(Header) == 64, "header should fill one cache line");
+  static constexpr char MAGIC[8] = {'L', 'O', 'G', 'R', 'I', 'N', 'G', '1'};
+
+  std::string filename;
+  int fd = -1;
+  std::size_t capacity;
+  std::size_t mappedSize;
+  char *mapped = nullptr;
+  Header *header = nullptr;
+  char *ring = nullptr;
+
+  // copies the retained bytes of a ring in logical order
+  static void linearize(const Header *header, const char *ring, char *out) {
+    std::size_t size = header->end - header->begin;
+    std::size_t pos = header->begin % header->capacity;
+    std::size_t first = std::min(size, header->capacity - pos);
+    std::memcpy(out, ring + pos, first);
+    std::memcpy(out + first, ring, size - first);
+  }
+
+public:
+  Logger5(const std::string &filename, std::size_t maxFileSize) {
+    if (maxFileSize == 0) {
+      throw std::runtime_error("Constructor: max file size must be non-zero");
+    }
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Constructor: cannot open file: " + filename);
+    }
+    mappedSize = sizeof(Header) + maxFileSize;
+    if (::ftruncate(fd, mappedSize) != 0) {
+      ::close(fd);
+      throw std::runtime_error("Constructor: cannot size file: " + filename);
+    }
+    void *addr =
+        ::mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      ::close(fd);
+      throw std::runtime_error("Constructor: cannot map file: " + filename);
+    }
+    this->filename = filename;
+    this->capacity = maxFileSize;
+    mapped = static_cast<char *>(addr);
+    header = reinterpret_cast<Header *>(mapped);
+    ring = mapped + sizeof(Header);
+    std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+    header->capacity = capacity;
+    header->begin = 0;
+    header->end = 0;
+  }
+  Logger5(const Logger5 &) = delete;
+  Logger5 &operator=(const Logger5 &) = delete;
+  ~Logger5() {
+    if (mapped != nullptr) {
+      ::munmap(mapped, mappedSize);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+  void write(std::string_view data) { write(data.data(), data.size()); }
+  void write(const char *src, std::size_t dataSize) {
+    // anything beyond the capacity would be overwritten by its own tail
+    if (dataSize > capacity) {
+      src += dataSize - capacity;
+      dataSize = capacity;
+    }
+    std::size_t pos = header->end % capacity;
+    std::size_t first = std::min(dataSize, capacity - pos);
+    std::memcpy(ring + pos, src, first);
+    std::memcpy(ring, src + first, dataSize - first);
+    header->end += dataSize;
+    if (header->end - header->begin > capacity) {
+      header->begin = header->end - capacity;
+    }
+  }
+  void flush() {
+    // writes land in the page cache directly, this only forces them to disk
+    ::msync(mapped, mappedSize, MS_SYNC);
+  }
+  std::string read() const {
+    std::string res(header->end - header->begin, '\0');
+    linearize(header, ring, res.data());
+    return res;
+  }
+
+  // writes the retained bytes of a ring file to a plain file, oldest first
+  static void exportTo(const std::string &ringFile, const std::string &outFile) {
+    int in = ::open(ringFile.c_str(), O_RDONLY);
+    if (in < 0) {
+      throw std::runtime_error("Export: cannot open file: " + ringFile);
+    }
+    struct stat st;
+    if (::fstat(in, &st) != 0 ||
+        static_cast<std::size_t>(st.st_size) < sizeof(Header)) {
+      ::close(in);
+      throw std::runtime_error("Export: not a ring file: " + ringFile);
+    }
+    std::size_t size = st.st_size;
+    void *addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, in, 0);
+    ::close(in);
+    if (addr == MAP_FAILED) {
+      throw std::runtime_error("Export: cannot map file: " + ringFile);
+    }
+    const char *base = static_cast<const char *>(addr);
+    const Header *header = reinterpret_cast<const Header *>(base);
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header->capacity == 0 ||
+        sizeof(Header) + header->capacity > size ||
+        header->end - header->begin > header->capacity) {
+      ::munmap(addr, size);
+      throw std::runtime_error("Export: corrupt ring header: " + ringFile);
+    }
+    std::string res(header->end - header->begin, '\0');
+    linearize(header, base + sizeof(Header), res.data());
+    ::munmap(addr, size);
+    std::ofstream out(outFile, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw std::runtime_error("Export: cannot open file: " + outFile);
+    }
+    out.write(res.data(), res.size());
+  }
+};
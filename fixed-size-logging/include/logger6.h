@@ -0,0 +1,75 @@
+#pragma once
+
+#include "io_backend.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Logger4 with a pluggable I/O backend and double buffering
+//
+// a full buffer is handed to the backend and the caller carries on in the
+// other buffer, so with an asynchronous backend the write overlaps with
+// filling the next 8KB. on wraparound the retained tail and the new data are
+// assembled in temp and rewritten from offset 0 in a single submission.
+
+template <typename Backend = FstreamBackend> class Logger6 {
+private:
+  const int BUFFER_SIZE = 8 * 1024; // 8KB buffer size
+  Backend backend;
+  std::size_t maxFileSize;
+  std::size_t fileSize = 0;
+  std::vector<char> buffers[2];
+  int active = 0;
+  std::size_t bufferSize = 0;
+  std::vector<char> temp;
+
+public:
+  Logger6(const std::string &filename, std::size_t maxFileSize) {
+    backend.open(filename);
+    this->maxFileSize = maxFileSize;
+    buffers[0].resize(BUFFER_SIZE);
+    buffers[1].resize(BUFFER_SIZE);
+    temp.resize(maxFileSize);
+  }
+  ~Logger6() {
+    flush();
+    backend.close(fileSize);
+  }
+  void write(std::string_view data) { write(data.data(), data.size()); }
+  void write(const char *src, std::size_t dataSize) {
+    while (dataSize > 0) {
+      if (bufferSize == static_cast<std::size_t>(BUFFER_SIZE) ||
+          (bufferSize + dataSize > static_cast<std::size_t>(BUFFER_SIZE) &&
+           dataSize <= static_cast<std::size_t>(BUFFER_SIZE))) {
+        flush();
+      }
+      std::size_t n = std::min(dataSize, BUFFER_SIZE - bufferSize);
+      std::memcpy(buffers[active].data() + bufferSize, src, n);
+      bufferSize += n;
+      src += n;
+      dataSize -= n;
+    }
+  }
+  void flush() {
+    if (bufferSize == 0) {
+      return;
+    }
+    const char *data = buffers[active].data();
+    if (fileSize + bufferSize > maxFileSize) {
+      std::size_t newDataSize = std::min(bufferSize, maxFileSize);
+      std::size_t oldDataSize = std::min(fileSize, maxFileSize - newDataSize);
+      backend.read(temp.data(), oldDataSize, fileSize - oldDataSize);
+      std::memcpy(temp.data() + oldDataSize, data + bufferSize - newDataSize,
+                  newDataSize);
+      backend.submit(temp.data(), oldDataSize + newDataSize, 0);
+      fileSize = oldDataSize + newDataSize;
+    } else {
+      backend.submit(data, bufferSize, fileSize);
+      fileSize += bufferSize;
+      active ^= 1; // the submitted buffer stays untouched until the next one
+    }
+    bufferSize = 0;
+  }
+};
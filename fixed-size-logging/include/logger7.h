@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+// append-only segment files instead of shifting data inside one file
+//
+// the log is split into "<filename>.<index>" files of segmentSize bytes.
+// segment i holds logical bytes [i * segmentSize, (i + 1) * segmentSize), so
+// once the newest maxFileSize bytes start past a segment it is deleted and
+// trimming costs the same no matter how large the cap is. the retained bytes
+// are read back in order with Logger7Reader.
+
+class Logger7 {
+private:
+  const int BUFFER_SIZE = 8 * 1024; // 8KB buffer size
+  std::string filename;
+  std::size_t maxFileSize;
+  std::size_t segmentSize;
+  std::vector<char> buffer;
+  std::size_t bufferSize = 0;
+  int fd = -1;
+  std::uint64_t total = 0;        // logical bytes written so far
+  std::uint64_t firstSegment = 0; // oldest segment still on disk
+  std::uint64_t currentSegment = 0;
+  std::size_t segmentFill = 0;
+
+  std::uint64_t start() const {
+    return total > maxFileSize ? total - maxFileSize : 0;
+  }
+
+  void openSegment() {
+    std::string name = segmentName(filename, currentSegment);
+    fd = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Logger7: cannot open segment: " + name);
+    }
+    segmentFill = 0;
+  }
+
+  void expire() {
+    while (firstSegment < currentSegment &&
+           (firstSegment + 1) * segmentSize <= start()) {
+      std::filesystem::remove(segmentName(filename, firstSegment));
+      firstSegment++;
+    }
+  }
+
+public:
+  static std::string segmentName(const std::string &filename,
+                                 std::uint64_t index) {
+    return filename + "." + std::to_string(index);
+  }
+  static std::string metaName(const std::string &filename) {
+    return filename + ".meta";
+  }
+  // indices of the segment files on disk, sorted
+  static std::vector<std::uint64_t> segments(const std::string &filename) {
+    std::filesystem::path base(filename);
+    std::filesystem::path dir = base.has_parent_path() ? base.parent_path() : ".";
+    std::string prefix = base.filename().string() + ".";
+    std::vector<std::uint64_t> indices;
+    for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+      std::string name = entry.path().filename().string();
+      if (name.size() > prefix.size() &&
+          name.compare(0, prefix.size(), prefix) == 0 &&
+          name.find_first_not_of("0123456789", prefix.size()) ==
+              std::string::npos) {
+        indices.push_back(std::stoull(name.substr(prefix.size())));
+      }
+    }
+    std::sort(indices.begin(), indices.end());
+    return indices;
+  }
+
+  // segmentSize defaults to an eighth of the cap
+  Logger7(const std::string &filename, std::size_t maxFileSize,
+          std::size_t segmentSize = 0) {
+    if (segmentSize == 0) {
+      segmentSize = std::max<std::size_t>(maxFileSize / 8, 4096);
+    }
+    this->filename = filename;
+    this->maxFileSize = maxFileSize;
+    this->segmentSize = segmentSize;
+    // segments left over from an earlier run would confuse the reader
+    for (std::uint64_t index : segments(filename)) {
+      std::filesystem::remove(segmentName(filename, index));
+    }
+    std::ofstream meta(metaName(filename), std::ios::trunc);
+    if (!meta) {
+      throw std::runtime_error("Constructor: cannot open file: " +
+                               metaName(filename));
+    }
+    meta << segmentSize << " " << maxFileSize << "\n";
+    buffer.resize(BUFFER_SIZE);
+    openSegment();
+  }
+  Logger7(const Logger7 &) = delete;
+  Logger7 &operator=(const Logger7 &) = delete;
+  ~Logger7() {
+    if (fd >= 0) {
+      flush();
+      ::close(fd);
+    }
+  }
+  void write(std::string_view data) { write(data.data(), data.size()); }
+  void write(const char *src, std::size_t dataSize) {
+    while (dataSize > 0) {
+      if (bufferSize == static_cast<std::size_t>(BUFFER_SIZE) ||
+          (bufferSize + dataSize > static_cast<std::size_t>(BUFFER_SIZE) &&
+           dataSize <= static_cast<std::size_t>(BUFFER_SIZE))) {
+        flush();
+      }
+      std::size_t n = std::min(dataSize, BUFFER_SIZE - bufferSize);
+      std::memcpy(buffer.data() + bufferSize, src, n);
+      bufferSize += n;
+      src += n;
+      dataSize -= n;
+    }
+  }
+  void flush() {
+    const char *src = buffer.data();
+    std::size_t n = bufferSize;
+    while (n > 0) {
+      if (segmentFill == segmentSize) {
+        ::close(fd);
+        currentSegment++;
+        openSegment();
+      }
+      std::size_t chunk = std::min(n, segmentSize - segmentFill);
+      if (::write(fd, src, chunk) != static_cast<ssize_t>(chunk)) {
+        throw std::runtime_error("Logger7: write failed: " + filename);
+      }
+      segmentFill += chunk;
+      total += chunk;
+      src += chunk;
+      n -= chunk;
+    }
+    bufferSize = 0;
+    expire();
+  }
+};
+
+// streams the newest maxFileSize bytes of a Logger7 log, oldest first
+class Logger7Reader {
+private:
+  const std::size_t CHUNK_SIZE = 64 * 1024;
+  std::string filename;
+  std::uint64_t segment = 0;
+  std::uint64_t lastSegment = 0;
+  std::uint64_t skip = 0; // bytes of the first segment that aged out
+  std::ifstream file;
+  bool done = false;
+
+public:
+  Logger7Reader(const std::string &filename) {
+    this->filename = filename;
+    std::size_t segmentSize, maxFileSize;
+    std::ifstream meta(Logger7::metaName(filename));
+    if (!(meta >> segmentSize >> maxFileSize)) {
+      throw std::runtime_error("Logger7Reader: cannot read " +
+                               Logger7::metaName(filename));
+    }
+    std::vector<std::uint64_t> indices = Logger7::segments(filename);
+    if (indices.empty()) {
+      done = true;
+      return;
+    }
+    std::uint64_t first = indices.front();
+    std::uint64_t last = indices.back();
+    // every segment but the newest is full
+    std::uint64_t total =
+        last * segmentSize +
+        std::filesystem::file_size(Logger7::segmentName(filename, last));
+    std::uint64_t start = total > maxFileSize ? total - maxFileSize : 0;
+    segment = first;
+    lastSegment = last;
+    skip = start > first * segmentSize ? start - first * segmentSize : 0;
+  }
+
+  // reads the next piece of the log into chunk, false once everything was read
+  bool next(std::string &chunk) {
+    while (!done) {
+      if (!file.is_open()) {
+        file.open(Logger7::segmentName(filename, segment), std::ios::binary);
+        if (!file) {
+          throw std::runtime_error("Logger7Reader: missing segment " +
+                                   std::to_string(segment));
+        }
+        file.seekg(skip, std::ios::beg);
+        skip = 0;
+      }
+      chunk.resize(CHUNK_SIZE);
+      file.read(chunk.data(), CHUNK_SIZE);
+      chunk.resize(file.gcount());
+      if (!chunk.empty()) {
+        return true;
+      }
+      file.close();
+      if (segment == lastSegment) {
+        done = true;
+      }
+      segment++;
+    }
+    return false;
+  }
+
+  void exportTo(const std::string &outFile) {
+    std::ofstream out(outFile, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw std::runtime_error("Export: cannot open file: " + outFile);
+    }
+    std::string chunk;
+    while (next(chunk)) {
+      out.write(chunk.data(), chunk.size());
+    }
+  }
+};
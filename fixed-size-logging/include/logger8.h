@@ -0,0 +1,186 @@
+#pragma once
+
+#include "lz.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+// compresses every 8KB buffer before it reaches the file
+//
+// maxFileSize caps the compressed bytes, so repetitive logs keep several
+// times more history in the same space. each flush appends one frame:
+// [u32 raw size][u32 stored size][block], the top bit of the stored size
+// marks a block kept uncompressed because it did not shrink. the oldest
+// whole frames are dropped on wraparound, Logger8Reader decompresses the
+// retained frames.
+
+class Logger8 {
+public:
+  static constexpr std::uint32_t STORED = 0x80000000u;
+  static constexpr std::size_t FRAME_HEADER = 2 * sizeof(std::uint32_t);
+
+private:
+  struct Frame {
+    std::size_t size;
+    std::size_t rawSize;
+  };
+
+  const int BUFFER_SIZE = 8 * 1024; // 8KB buffer size
+  std::string filename;
+  int fd = -1;
+  std::size_t maxFileSize;
+  std::size_t fileSize = 0;
+  std::vector<char> buffer;
+  std::size_t bufferSize = 0;
+  std::vector<char> frame;
+  std::vector<char> temp;
+  std::deque<Frame> frames; // frames in the file, oldest first
+  std::uint64_t rawBytes = 0; // uncompressed bytes the file holds
+
+  void appendFrame(std::size_t frameSize, std::size_t rawSize) {
+    if (frameSize > maxFileSize) {
+      return; // can never fit, same as dropping it right away
+    }
+    bool shrunk = false;
+    if (fileSize + frameSize > maxFileSize) {
+      std::size_t offset = 0;
+      while (fileSize - offset + frameSize > maxFileSize) {
+        offset += frames.front().size;
+        rawBytes -= frames.front().rawSize;
+        frames.pop_front();
+      }
+      std::size_t oldDataSize = fileSize - offset;
+      if (::pread(fd, temp.data(), oldDataSize, offset) != static_cast<ssize_t>(oldDataSize) ||
+          ::pwrite(fd, temp.data(), oldDataSize, 0) != static_cast<ssize_t>(oldDataSize)) {
+        throw std::runtime_error("Logger8: compaction failed: " + filename);
+      }
+      fileSize = oldDataSize;
+      shrunk = true;
+    }
+    if (::pwrite(fd, frame.data(), frameSize, fileSize) != static_cast<ssize_t>(frameSize)) {
+      throw std::runtime_error("Logger8: write failed: " + filename);
+    }
+    fileSize += frameSize;
+    frames.push_back({frameSize, rawSize});
+    rawBytes += rawSize;
+    if (shrunk && ::ftruncate(fd, fileSize) != 0) {
+      throw std::runtime_error("Logger8: truncate failed: " + filename);
+    }
+  }
+
+public:
+  Logger8(const std::string &filename, std::size_t maxFileSize) {
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Constructor: cannot open file: " + filename);
+    }
+    this->filename = filename;
+    this->maxFileSize = maxFileSize;
+    buffer.resize(BUFFER_SIZE);
+    frame.resize(FRAME_HEADER + lz::compressBound(BUFFER_SIZE));
+    temp.resize(maxFileSize);
+  }
+  ~Logger8() {
+    if (fd >= 0) {
+      try {
+        flush();
+      } catch (const std::exception &) {
+        // nothing left to report the error to
+      }
+      ::close(fd);
+    }
+  }
+  void write(std::string_view data) { write(data.data(), data.size()); }
+  void write(const char *src, std::size_t dataSize) {
+    while (dataSize > 0) {
+      if (bufferSize == static_cast<std::size_t>(BUFFER_SIZE) ||
+          (bufferSize + dataSize > static_cast<std::size_t>(BUFFER_SIZE) &&
+           dataSize <= static_cast<std::size_t>(BUFFER_SIZE))) {
+        flush();
+      }
+      std::size_t n = std::min(dataSize, BUFFER_SIZE - bufferSize);
+      std::memcpy(buffer.data() + bufferSize, src, n);
+      bufferSize += n;
+      src += n;
+      dataSize -= n;
+    }
+  }
+  void flush() {
+    if (bufferSize == 0) {
+      return;
+    }
+    std::uint32_t rawSize = bufferSize;
+    std::uint32_t storedSize =
+        lz::compress(buffer.data(), bufferSize, frame.data() + FRAME_HEADER);
+    if (storedSize >= rawSize) {
+      std::memcpy(frame.data() + FRAME_HEADER, buffer.data(), rawSize);
+      storedSize = rawSize | STORED;
+    }
+    std::memcpy(frame.data(), &rawSize, sizeof(rawSize));
+    std::memcpy(frame.data() + sizeof(rawSize), &storedSize, sizeof(storedSize));
+    appendFrame(FRAME_HEADER + (storedSize & ~STORED), rawSize);
+    bufferSize = 0;
+  }
+  // uncompressed bytes currently retained, compare against maxFileSize for
+  // the effective history ratio
+  std::uint64_t retainedBytes() const { return rawBytes; }
+};
+
+// decompresses a Logger8 file, oldest data first
+class Logger8Reader {
+private:
+  std::string data;
+
+public:
+  Logger8Reader(const std::string &filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Logger8Reader: cannot open file: " + filename);
+    }
+    std::string raw((std::istreambuf_iterator<char>(file)),
+                    std::istreambuf_iterator<char>());
+    std::size_t ptr = 0;
+    while (ptr < raw.size()) {
+      std::uint32_t rawSize, storedSize;
+      if (raw.size() - ptr < Logger8::FRAME_HEADER) {
+        throw std::runtime_error("Logger8Reader: truncated frame");
+      }
+      std::memcpy(&rawSize, raw.data() + ptr, sizeof(rawSize));
+      std::memcpy(&storedSize, raw.data() + ptr + sizeof(rawSize),
+                  sizeof(storedSize));
+      ptr += Logger8::FRAME_HEADER;
+      bool stored = storedSize & Logger8::STORED;
+      storedSize &= ~Logger8::STORED;
+      if (raw.size() - ptr < storedSize) {
+        throw std::runtime_error("Logger8Reader: truncated frame");
+      }
+      std::size_t offset = data.size();
+      data.resize(offset + rawSize);
+      if (stored) {
+        std::memcpy(data.data() + offset, raw.data() + ptr, rawSize);
+      } else {
+        lz::decompress(raw.data() + ptr, storedSize, data.data() + offset,
+                       rawSize);
+      }
+      ptr += storedSize;
+    }
+  }
+  const std::string &read() const { return data; }
+  // writes the newest maxBytes (all of it when 0) to a plain file
+  void exportTo(const std::string &outFile, std::size_t maxBytes = 0) const {
+    std::ofstream out(outFile, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw std::runtime_error("Export: cannot open file: " + outFile);
+    }
+    std::size_t size = maxBytes == 0 ? data.size() : std::min(maxBytes, data.size());
+    out.write(data.data() + data.size() - size, size);
+  }
+};
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// crash safe fixed-size log that survives restarts
+//
+// file layout: [checkpoint slot 0][checkpoint slot 1][capacity bytes of ring]
+// every write() becomes one record: [u32 length][u32 crc][u64 offset][data],
+// offset is the record's logical position in the ring and the crc covers
+// offset + data, so torn writes and bytes left over from an earlier lap are
+// both rejected. checkpoints hold the logical begin/end and alternate
+// between the two slots, a torn checkpoint leaves the other one intact.
+// on open the newest valid checkpoint is loaded and only records written
+// after it are scanned, which bounds recovery by CHECKPOINT_BYTES rather
+// than by the cap.
+
+enum class FsyncPolicy {
+  Never,    // leave it to the page cache, survives process crashes only
+  PerFlush, // fdatasync after every flush
+  Interval  // fdatasync at most once per interval
+};
+
+namespace wal {
+
+inline std::uint32_t crc32(const void *data, std::size_t n,
+                           std::uint32_t crc = 0) {
+  static const std::array<std::uint32_t, 256> table = [] {
+    std::array<std::uint32_t, 256> t{};
+    for (std::uint32_t i = 0; i < 256; i++) {
+      std::uint32_t c = i;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      t[i] = c;
+    }
+    return t;
+  }();
+  const unsigned char *p = static_cast<const unsigned char *>(data);
+  crc = ~crc;
+  for (std::size_t i = 0; i < n; i++) {
+    crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+struct RecordHeader {
+  std::uint32_t length;
+  std::uint32_t crc;
+  std::uint64_t offset;
+};
+static_assert(sizeof(RecordHeader) == 16, "record header must be packed");
+
+struct Checkpoint {
+  std::uint32_t magic;
+  std::uint32_t crc; // over everything after this field
+  std::uint64_t seq;
+  std::uint64_t capacity;
+  std::uint64_t begin;
+  std::uint64_t end;
+  char padding[24];
+};
+static_assert(sizeof(Checkpoint) == 64, "checkpoint slot is 64 bytes");
+
+constexpr std::uint32_t MAGIC = 0x4c4f4739; // "LOG9"
+constexpr std::size_t DATA_OFFSET = 2 * sizeof(Checkpoint);
+
+inline std::uint32_t checkpointCrc(const Checkpoint &cp) {
+  return crc32(&cp.seq, sizeof(Checkpoint) - offsetof(Checkpoint, seq));
+}
+
+inline std::uint32_t recordCrc(std::uint64_t offset, const char *data,
+                               std::size_t n) {
+  return crc32(data, n, crc32(&offset, sizeof(offset)));
+}
+
+// logical reads and writes, split in two where the ring wraps
+inline bool readRing(int fd, std::uint64_t capacity, std::uint64_t pos,
+                     char *dst, std::size_t n) {
+  std::size_t physical = pos % capacity;
+  std::size_t first = std::min<std::size_t>(n, capacity - physical);
+  return ::pread(fd, dst, first, DATA_OFFSET + physical) ==
+             static_cast<ssize_t>(first) &&
+         ::pread(fd, dst + first, n - first, DATA_OFFSET) ==
+             static_cast<ssize_t>(n - first);
+}
+
+inline bool writeRing(int fd, std::uint64_t capacity, std::uint64_t pos,
+                      const char *src, std::size_t n) {
+  std::size_t physical = pos % capacity;
+  std::size_t first = std::min<std::size_t>(n, capacity - physical);
+  return ::pwrite(fd, src, first, DATA_OFFSET + physical) ==
+             static_cast<ssize_t>(first) &&
+         ::pwrite(fd, src + first, n - first, DATA_OFFSET) ==
+             static_cast<ssize_t>(n - first);
+}
+
+// newest valid checkpoint slot, false if neither slot is usable
+inline bool loadCheckpoint(int fd, Checkpoint &cp) {
+  Checkpoint slots[2];
+  if (::pread(fd, slots, sizeof(slots), 0) != sizeof(slots)) {
+    return false;
+  }
+  bool found = false;
+  for (const Checkpoint &slot : slots) {
+    if (slot.magic == MAGIC && slot.crc == checkpointCrc(slot) &&
+        slot.capacity > 0 && slot.end - slot.begin <= slot.capacity &&
+        (!found || slot.seq > cp.seq)) {
+      cp = slot;
+      found = true;
+    }
+  }
+  return found;
+}
+
+// checks the record at pos, filling data with its payload
+inline bool validRecord(int fd, const Checkpoint &cp, std::uint64_t pos,
+                        RecordHeader &header, std::vector<char> &data) {
+  if (cp.capacity - (pos - cp.begin) < sizeof(RecordHeader) ||
+      !readRing(fd, cp.capacity, pos, reinterpret_cast<char *>(&header),
+                sizeof(header)) ||
+      header.offset != pos ||
+      header.length > cp.capacity - (pos - cp.begin) - sizeof(RecordHeader)) {
+    return false;
+  }
+  data.resize(header.length);
+  return readRing(fd, cp.capacity, pos + sizeof(header), data.data(),
+                  header.length) &&
+         header.crc == recordCrc(pos, data.data(), header.length);
+}
+
+// advances cp.end over records written after the checkpoint
+inline void scanForward(int fd, Checkpoint &cp) {
+  RecordHeader header;
+  std::vector<char> data;
+  while (validRecord(fd, cp, cp.end, header, data)) {
+    cp.end += sizeof(header) + header.length;
+  }
+}
+
+} // namespace wal
+
+class Logger9 {
+private:
+  static constexpr std::size_t HEADER = sizeof(wal::RecordHeader);
+  // upper bound on what recovery has to scan past the last checkpoint
+  static constexpr std::uint64_t CHECKPOINT_BYTES = 1024 * 1024;
+
+  const int BUFFER_SIZE = 8 * 1024; // 8KB buffer size
+  std::string filename;
+  int fd = -1;
+  FsyncPolicy policy;
+  std::chrono::milliseconds interval;
+  std::chrono::steady_clock::time_point lastSync;
+  wal::Checkpoint state{};
+  std::uint64_t checkpointedEnd = 0;
+  std::vector<char> buffer;
+  std::size_t bufferSize = 0;
+
+  void writeCheckpoint() {
+    state.magic = wal::MAGIC;
+    state.seq++;
+    state.crc = wal::checkpointCrc(state);
+    char slot[sizeof(state)];
+    std::memcpy(slot, &state, sizeof(state));
+    if (::pwrite(fd, slot, sizeof(slot), (state.seq % 2) * sizeof(slot)) !=
+        static_cast<ssize_t>(sizeof(slot))) {
+      throw std::runtime_error("Logger9: checkpoint write failed: " + filename);
+    }
+    checkpointedEnd = state.end;
+  }
+
+  void sync() {
+    if (::fdatasync(fd) != 0) {
+      throw std::runtime_error("Logger9: sync failed: " + filename);
+    }
+    lastSync = std::chrono::steady_clock::now();
+  }
+
+  // records and batches up to this size go through the buffer, so a
+  // batch always fits the ring
+  std::size_t batchLimit() const {
+    return std::min<std::size_t>(BUFFER_SIZE, state.capacity);
+  }
+
+  // appends whole encoded records to the ring, n <= capacity
+  void commit(const char *data, std::size_t n) {
+    if (n == 0) {
+      return;
+    }
+    if (n > state.capacity) {
+      throw std::runtime_error("Logger9: batch larger than the cap: " + filename);
+    }
+    bool dropped = false;
+    while (state.end + n - state.begin > state.capacity && state.begin != state.end) {
+      wal::RecordHeader oldest;
+      if (!wal::readRing(fd, state.capacity, state.begin,
+                         reinterpret_cast<char *>(&oldest), HEADER)) {
+        throw std::runtime_error("Logger9: read failed: " + filename);
+      }
+      state.begin += HEADER + oldest.length;
+      dropped = true;
+    }
+    if (dropped) {
+      // the new begin has to be on disk before the records it skips are
+      // overwritten, otherwise recovery could start inside new data
+      writeCheckpoint();
+      if (policy != FsyncPolicy::Never) {
+        sync();
+      }
+    }
+    if (!wal::writeRing(fd, state.capacity, state.end, data, n)) {
+      throw std::runtime_error("Logger9: write failed: " + filename);
+    }
+    state.end += n;
+    if (policy == FsyncPolicy::PerFlush ||
+        (policy == FsyncPolicy::Interval &&
+         std::chrono::steady_clock::now() - lastSync >= interval)) {
+      sync();
+    }
+    if (state.end - checkpointedEnd >= CHECKPOINT_BYTES) {
+      writeCheckpoint();
+    }
+  }
+
+  char *encode(char *out, std::string_view data, std::uint64_t offset) {
+    wal::RecordHeader header{static_cast<std::uint32_t>(data.size()),
+                             wal::recordCrc(offset, data.data(), data.size()),
+                             offset};
+    std::memcpy(out, &header, HEADER);
+    std::memcpy(out + HEADER, data.data(), data.size());
+    return out + HEADER + data.size();
+  }
+
+public:
+  // reopens and recovers an existing log with the same cap, anything else
+  // at filename is replaced by an empty log
+  Logger9(const std::string &filename, std::size_t maxFileSize,
+          FsyncPolicy policy = FsyncPolicy::Never,
+          std::chrono::milliseconds interval = std::chrono::milliseconds(1000)) {
+    if (maxFileSize < HEADER) {
+      throw std::runtime_error("Constructor: max file size too small");
+    }
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Constructor: cannot open file: " + filename);
+    }
+    this->filename = filename;
+    this->policy = policy;
+    this->interval = interval;
+    lastSync = std::chrono::steady_clock::now();
+    buffer.resize(BUFFER_SIZE);
+    if (wal::loadCheckpoint(fd, state) && state.capacity == maxFileSize) {
+      wal::scanForward(fd, state);
+    } else {
+      std::memset(&state, 0, sizeof(state));
+      state.capacity = maxFileSize;
+      if (::ftruncate(fd, 0) != 0 ||
+          ::ftruncate(fd, wal::DATA_OFFSET + maxFileSize) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Constructor: cannot size file: " + filename);
+      }
+    }
+    writeCheckpoint();
+  }
+  Logger9(const Logger9 &) = delete;
+  Logger9 &operator=(const Logger9 &) = delete;
+  ~Logger9() {
+    if (fd >= 0) {
+      try {
+        flush();
+        writeCheckpoint();
+        if (policy != FsyncPolicy::Never) {
+          sync();
+        }
+      } catch (const std::exception &) {
+        // the last checkpoint on disk stays valid, recovery picks it up
+      }
+      ::close(fd);
+    }
+  }
+  void write(const char *data, std::size_t size) {
+    write(std::string_view(data, size));
+  }
+  void write(std::string_view data) {
+    std::size_t recordSize = HEADER + data.size();
+    if (recordSize > state.capacity) {
+      return; // could never be retained
+    }
+    if (bufferSize + recordSize > batchLimit()) {
+      flush();
+    }
+    if (recordSize > batchLimit()) {
+      std::vector<char> record(recordSize);
+      encode(record.data(), data, state.end);
+      commit(record.data(), recordSize);
+      return;
+    }
+    encode(buffer.data() + bufferSize, data, state.end + bufferSize);
+    bufferSize += recordSize;
+  }
+  void flush() {
+    commit(buffer.data(), bufferSize);
+    bufferSize = 0;
+  }
+  // drops the buffer and closes without a final checkpoint, the way a
+  // killed process would leave the file
+  void abandon() {
+    ::close(fd);
+    fd = -1;
+  }
+  std::uint64_t retainedBytes() const { return state.end - state.begin; }
+
+  // writes the payloads of all valid records, oldest first, to a plain file
+  static void exportTo(const std::string &logFile, const std::string &outFile) {
+    int in = ::open(logFile.c_str(), O_RDONLY);
+    if (in < 0) {
+      throw std::runtime_error("Export: cannot open file: " + logFile);
+    }
+    wal::Checkpoint cp;
+    if (!wal::loadCheckpoint(in, cp)) {
+      ::close(in);
+      throw std::runtime_error("Export: no valid checkpoint: " + logFile);
+    }
+    wal::scanForward(in, cp);
+    std::ofstream out(outFile, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      ::close(in);
+      throw std::runtime_error("Export: cannot open file: " + outFile);
+    }
+    wal::RecordHeader header;
+    std::vector<char> data;
+    for (std::uint64_t pos = cp.begin; pos < cp.end;
+         pos += HEADER + header.length) {
+      if (!wal::validRecord(in, cp, pos, header, data)) {
+        ::close(in);
+        throw std::runtime_error("Export: corrupt record: " + logFile);
+      }
+      out.write(data.data(), data.size());
+    }
+    ::close(in);
+  }
+};
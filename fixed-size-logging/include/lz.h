@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// small self-contained LZ77 codec in the style of the LZ4 block format
+//
+// a block is a list of sequences: [token][literal length ext][literals]
+// [2 byte offset][match length ext]. the token's high nibble is the literal
+// length, the low nibble the match length minus MIN_MATCH; 15 means more
+// length bytes follow (each 255 adds on, the first byte < 255 ends it). the
+// final sequence has literals only. blocks are at most MAX_BLOCK bytes so
+// offsets always fit in 16 bits.
+
+namespace lz {
+
+constexpr std::size_t MIN_MATCH = 4;
+constexpr std::size_t MAX_BLOCK = 65535;
+constexpr int HASH_BITS = 12;
+
+// worst case output size for n input bytes
+constexpr std::size_t compressBound(std::size_t n) { return n + n / 255 + 16; }
+
+inline std::uint32_t read32(const char *p) {
+  std::uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline std::uint32_t hash(std::uint32_t v) {
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+inline char *putLength(char *out, std::size_t length) {
+  while (length >= 255) {
+    *out++ = static_cast<char>(255);
+    length -= 255;
+  }
+  *out++ = static_cast<char>(length);
+  return out;
+}
+
+inline char *putSequence(char *out, const char *literals, std::size_t literalSize,
+                         std::size_t offset, std::size_t matchSize) {
+  std::size_t matchCode = matchSize - MIN_MATCH;
+  char *token = out++;
+  *token = static_cast<char>((std::min<std::size_t>(literalSize, 15) << 4) |
+                             std::min<std::size_t>(matchCode, 15));
+  if (literalSize >= 15) {
+    out = putLength(out, literalSize - 15);
+  }
+  std::memcpy(out, literals, literalSize);
+  out += literalSize;
+  out[0] = static_cast<char>(offset & 0xff);
+  out[1] = static_cast<char>(offset >> 8);
+  out += 2;
+  if (matchCode >= 15) {
+    out = putLength(out, matchCode - 15);
+  }
+  return out;
+}
+
+// compresses n <= MAX_BLOCK bytes into dst (compressBound(n) bytes), returns
+// the compressed size
+inline std::size_t compress(const char *src, std::size_t n, char *dst) {
+  if (n > MAX_BLOCK) {
+    throw std::runtime_error("lz: block too large");
+  }
+  std::uint16_t table[1 << HASH_BITS] = {}; // position + 1, 0 means empty
+  char *out = dst;
+  std::size_t ip = 0;
+  std::size_t anchor = 0;
+  std::size_t misses = 0;
+  while (ip + MIN_MATCH <= n) {
+    std::uint32_t seq = read32(src + ip);
+    std::uint32_t h = hash(seq);
+    std::size_t candidate = table[h];
+    table[h] = static_cast<std::uint16_t>(ip + 1);
+    if (candidate == 0 || read32(src + candidate - 1) != seq) {
+      // skip faster through data that does not compress
+      ip += 1 + (misses++ >> 5);
+      continue;
+    }
+    candidate--;
+    std::size_t matchSize = MIN_MATCH;
+    while (ip + matchSize < n && src[candidate + matchSize] == src[ip + matchSize]) {
+      matchSize++;
+    }
+    out = putSequence(out, src + anchor, ip - anchor, ip - candidate, matchSize);
+    ip += matchSize;
+    anchor = ip;
+    misses = 0;
+  }
+  // trailing literals, no match part
+  std::size_t literalSize = n - anchor;
+  *out++ = static_cast<char>(std::min<std::size_t>(literalSize, 15) << 4);
+  if (literalSize >= 15) {
+    out = putLength(out, literalSize - 15);
+  }
+  std::memcpy(out, src + anchor, literalSize);
+  out += literalSize;
+  return out - dst;
+}
+
+// decompresses a block into dst, which must hold rawSize bytes
+inline void decompress(const char *src, std::size_t n, char *dst,
+                       std::size_t rawSize) {
+  const unsigned char *in = reinterpret_cast<const unsigned char *>(src);
+  const unsigned char *end = in + n;
+  std::size_t op = 0;
+  auto getLength = [&](std::size_t length) {
+    if (length == 15) {
+      unsigned char byte;
+      do {
+        if (in >= end) {
+          throw std::runtime_error("lz: truncated block");
+        }
+        byte = *in++;
+        length += byte;
+      } while (byte == 255);
+    }
+    return length;
+  };
+  while (in < end) {
+    unsigned char token = *in++;
+    std::size_t literalSize = getLength(token >> 4);
+    if (literalSize > static_cast<std::size_t>(end - in) ||
+        literalSize > rawSize - op) {
+      throw std::runtime_error("lz: corrupt literals");
+    }
+    std::memcpy(dst + op, in, literalSize);
+    in += literalSize;
+    op += literalSize;
+    if (in == end) {
+      break; // last sequence
+    }
+    if (end - in < 2) {
+      throw std::runtime_error("lz: truncated block");
+    }
+    std::size_t offset = in[0] | (in[1] << 8);
+    in += 2;
+    std::size_t matchSize = getLength(token & 15) + MIN_MATCH;
+    if (offset == 0 || offset > op || matchSize > rawSize - op) {
+      throw std::runtime_error("lz: corrupt match");
+    }
+    const char *match = dst + op - offset;
+    if (offset >= matchSize) {
+      std::memcpy(dst + op, match, matchSize);
+    } else {
+      // overlapping copy repeats the last offset bytes
+      for (std::size_t i = 0; i < matchSize; i++) {
+        dst[op + i] = match[i];
+      }
+    }
+    op += matchSize;
+  }
+  if (op != rawSize) {
+    throw std::runtime_error("lz: size mismatch");
+  }
+}
+
+} // namespace lz
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// append-only storage for benchmark messages
+//
+// messages are copied back to back into large slabs and handed out as
+// string_views, so generating N messages costs N / SLAB_SIZE allocations
+// instead of N and the writes walk memory in order. messages larger than a
+// slab get a slab of their own. views stay valid until the arena is cleared
+// or destroyed.
+
+class MessageArena {
+private:
+  static constexpr std::size_t SLAB_SIZE = 1 << 20; // 1MB slabs
+
+  std::vector<std::unique_ptr<char[]>> slabs;
+  char *cursor = nullptr;
+  std::size_t remaining = 0;
+  std::size_t used = 0;
+
+public:
+  MessageArena() = default;
+  MessageArena(const MessageArena &) = delete;
+  MessageArena &operator=(const MessageArena &) = delete;
+
+  // n uninitialized bytes
+  char *allocate(std::size_t n) {
+    if (n > remaining) {
+      std::size_t size = std::max(n, SLAB_SIZE);
+      slabs.push_back(std::make_unique<char[]>(size));
+      cursor = slabs.back().get();
+      remaining = size;
+    }
+    char *res = cursor;
+    cursor += n;
+    remaining -= n;
+    used += n;
+    return res;
+  }
+  std::string_view add(std::string_view message) {
+    char *dst = allocate(message.size());
+    std::memcpy(dst, message.data(), message.size());
+    return {dst, message.size()};
+  }
+  std::size_t bytes() const { return used; }
+  void clear() {
+    slabs.clear();
+    cursor = nullptr;
+    remaining = 0;
+    used = 0;
+  }
+};
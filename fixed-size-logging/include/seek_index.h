@@ -0,0 +1,142 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// sparse seek index for Logger4
+//
+// every IntervalKB of flushed data the index notes where a record starts:
+// its offset in the stream of everything ever written, the number of
+// records (lines) before it and the wall clock time it was written.
+// offsets are logical, so the compaction in Logger4::flush, which drops
+// bytes from the front of the file, only moves the base (the logical
+// offset of the file's first byte) and never touches entries. the index
+// lives in "<log>.idx", a header followed by the entries, which are
+// appended as they are made. entries that aged out are dropped by
+// rewriting the file once they outnumber the live ones.
+//
+// Index = NoSeekIndex (the default) compiles to nothing, LogReader in
+// log_reader.h reads the index back.
+
+struct SeekEntry {
+  std::uint64_t offset;  // logical offset of a record start
+  std::uint64_t records; // records before it
+  std::int64_t timeNs;   // system_clock time of its write
+};
+
+struct SeekIndexHeader {
+  std::uint64_t magic;
+  std::uint64_t interval;
+  std::uint64_t base;
+};
+
+constexpr std::uint64_t SEEK_INDEX_MAGIC = 0x3158444947474f4c; // "LOGGIDX1"
+
+inline std::string seekIndexName(const std::string &log) { return log + ".idx"; }
+
+class NoSeekIndex {
+public:
+  NoSeekIndex(const std::string &) {}
+  void recordStart() {}
+  void flushed(const char *, std::size_t, std::size_t) {}
+};
+
+template <std::size_t IntervalKB = 64> class SeekIndex {
+private:
+  static constexpr std::uint64_t INTERVAL = IntervalKB * 1024;
+  std::string path;
+  int fd = -1;
+  std::uint64_t base = 0;    // logical offset of the first byte in the log
+  std::uint64_t written = 0; // logical end of the log
+  std::uint64_t records = 0;
+  std::int64_t bufferTime = 0; // first write into the current buffer
+  std::vector<SeekEntry> entries;
+  std::size_t dead = 0; // leading entries that aged out
+  bool good = true;
+
+  void put(const void *data, std::size_t n, std::uint64_t at) {
+    good = ::pwrite(fd, data, n, at) == static_cast<ssize_t>(n) && good;
+  }
+
+  void writeHeader() {
+    SeekIndexHeader header{SEEK_INDEX_MAGIC, INTERVAL, base};
+    put(&header, sizeof(header), 0);
+  }
+
+  // drops the dead entries, a reader that catches the file half written
+  // skips entries that do not start a record
+  void rewrite() {
+    entries.erase(entries.begin(), entries.begin() + dead);
+    dead = 0;
+    writeHeader();
+    put(entries.data(), entries.size() * sizeof(SeekEntry), sizeof(SeekIndexHeader));
+    good = ::ftruncate(fd, sizeof(SeekIndexHeader) + entries.size() * sizeof(SeekEntry)) == 0 && good;
+  }
+
+public:
+  SeekIndex(const std::string &log) : path(seekIndexName(log)) {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("SeekIndex: cannot open " + path);
+    }
+    writeHeader();
+  }
+  SeekIndex(SeekIndex &&other) noexcept
+      : path(std::move(other.path)), fd(std::exchange(other.fd, -1)),
+        base(other.base), written(other.written), records(other.records),
+        bufferTime(other.bufferTime), entries(std::move(other.entries)),
+        dead(other.dead), good(other.good) {}
+  SeekIndex(const SeekIndex &) = delete;
+  SeekIndex &operator=(const SeekIndex &) = delete;
+  ~SeekIndex() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  // the first write into an empty buffer
+  void recordStart() {
+    bufferTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::system_clock::now().time_since_epoch())
+                     .count();
+  }
+
+  // Logger4::flush dropped removed bytes from the front of the file, then
+  // appended data, which holds whole records
+  void flushed(const char *data, std::size_t n, std::size_t removed) {
+    if (removed > 0) {
+      base += removed;
+      while (dead < entries.size() && entries[dead].offset < base) {
+        dead++;
+      }
+      if (dead > 64 && dead > entries.size() - dead) {
+        rewrite();
+      } else {
+        writeHeader();
+      }
+    }
+    if (n == 0) {
+      return;
+    }
+    if (entries.size() == dead || written - entries.back().offset >= INTERVAL) {
+      entries.push_back({written, records, bufferTime});
+      put(&entries.back(), sizeof(SeekEntry),
+          sizeof(SeekIndexHeader) + (entries.size() - 1) * sizeof(SeekEntry));
+    }
+    for (const char *p = data, *end = data + n;
+         (p = static_cast<const char *>(std::memchr(p, '\n', end - p))) != nullptr; p++) {
+      records++;
+    }
+    written += n;
+  }
+
+  // false once a write to the index file failed, the log is unaffected
+  bool ok() const { return good; }
+};
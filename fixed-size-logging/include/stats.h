@@ -0,0 +1,199 @@
+#pragma once
+
+#include "histogram.h"
+#include "json.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// hot path counters for the loggers
+//
+// loggers take the statistics as a template policy: NoStats compiles to
+// nothing, LoggerStats keeps relaxed atomic counters in cache line padded
+// per-thread slots so producers on different threads never share a line.
+// stats() sums the slots into a StatsSnapshot, StatsDumper writes snapshots
+// to a JSON file periodically using the json-parser's Json::writeToFile.
+
+struct StatsSnapshot {
+  std::uint64_t writes = 0;
+  std::uint64_t bytes = 0;
+  std::uint64_t flushes = 0;
+  std::uint64_t wraps = 0;
+  std::uint64_t shiftedBytes = 0;
+  std::uint64_t dropped = 0;      // messages, see AsyncLogger::stats
+  std::uint64_t droppedBytes = 0; // aged out of the front of the file
+  LatencyHistogram flushLatency; // nanoseconds
+
+  JsonValue toJson() const {
+    JsonObject latency;
+    latency["count"] = {double(flushLatency.count())};
+    latency["mean_ns"] = {flushLatency.mean()};
+    latency["p50_ns"] = {double(flushLatency.percentile(50))};
+    latency["p99_ns"] = {double(flushLatency.percentile(99))};
+    latency["p999_ns"] = {double(flushLatency.percentile(99.9))};
+    latency["max_ns"] = {double(flushLatency.max())};
+    JsonObject obj;
+    obj["writes"] = {double(writes)};
+    obj["bytes"] = {double(bytes)};
+    obj["flushes"] = {double(flushes)};
+    obj["wraps"] = {double(wraps)};
+    obj["shifted_bytes"] = {double(shiftedBytes)};
+    obj["dropped"] = {double(dropped)};
+    obj["dropped_bytes"] = {double(droppedBytes)};
+    obj["flush_latency"] = {latency};
+    return {obj};
+  }
+};
+
+class NoStats {
+public:
+  static constexpr bool ENABLED = false;
+  struct FlushTimer {
+    FlushTimer(NoStats &) {}
+  };
+  void recordWrite(std::size_t) {}
+  void recordWrap(std::size_t) {}
+  void recordDrop(std::size_t) {}
+  StatsSnapshot snapshot() const { return {}; }
+};
+
+class LoggerStats {
+private:
+  static constexpr std::size_t SLOTS = 16;
+  struct alignas(64) Slot {
+    std::atomic<std::uint64_t> writes{0};
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<std::uint64_t> flushes{0};
+    std::atomic<std::uint64_t> wraps{0};
+    std::atomic<std::uint64_t> shiftedBytes{0};
+    std::atomic<std::uint64_t> droppedBytes{0};
+    std::atomic<std::uint64_t> flushNanos{0};
+    std::atomic<std::uint64_t> flushMaxNanos{0};
+    std::array<std::atomic<std::uint64_t>, LatencyHistogram::BUCKETS> flushLatency{};
+  };
+  std::vector<Slot> slots = std::vector<Slot>(SLOTS);
+
+  // threads are numbered on first use, more than SLOTS threads share slots
+  static std::size_t threadIndex() {
+    static std::atomic<std::size_t> next{0};
+    thread_local std::size_t index = next.fetch_add(1) % SLOTS;
+    return index;
+  }
+  Slot &slot() { return slots[threadIndex()]; }
+  static void add(std::atomic<std::uint64_t> &counter, std::uint64_t n) {
+    counter.fetch_add(n, std::memory_order_relaxed);
+  }
+
+public:
+  static constexpr bool ENABLED = true;
+
+  // times a flush from construction to destruction
+  class FlushTimer {
+  private:
+    LoggerStats &stats;
+    std::chrono::steady_clock::time_point start;
+
+  public:
+    FlushTimer(LoggerStats &stats)
+        : stats(stats), start(std::chrono::steady_clock::now()) {}
+    ~FlushTimer() {
+      stats.recordFlush(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count());
+    }
+  };
+
+  void recordWrite(std::size_t bytes) {
+    Slot &s = slot();
+    add(s.writes, 1);
+    add(s.bytes, bytes);
+  }
+  void recordFlush(std::uint64_t nanos) {
+    Slot &s = slot();
+    add(s.flushes, 1);
+    add(s.flushNanos, nanos);
+    add(s.flushLatency[LatencyHistogram::indexOf(nanos)], 1);
+    std::uint64_t max = s.flushMaxNanos.load(std::memory_order_relaxed);
+    while (nanos > max && !s.flushMaxNanos.compare_exchange_weak(
+                              max, nanos, std::memory_order_relaxed)) {
+    }
+  }
+  void recordWrap(std::size_t shiftedBytes) {
+    Slot &s = slot();
+    add(s.wraps, 1);
+    add(s.shiftedBytes, shiftedBytes);
+  }
+  void recordDrop(std::size_t bytes) { add(slot().droppedBytes, bytes); }
+
+  StatsSnapshot snapshot() const {
+    StatsSnapshot res;
+    for (const Slot &s : slots) {
+      res.writes += s.writes.load(std::memory_order_relaxed);
+      res.bytes += s.bytes.load(std::memory_order_relaxed);
+      res.flushes += s.flushes.load(std::memory_order_relaxed);
+      res.wraps += s.wraps.load(std::memory_order_relaxed);
+      res.shiftedBytes += s.shiftedBytes.load(std::memory_order_relaxed);
+      res.droppedBytes += s.droppedBytes.load(std::memory_order_relaxed);
+      for (std::size_t i = 0; i < LatencyHistogram::BUCKETS; i++) {
+        std::uint64_t n = s.flushLatency[i].load(std::memory_order_relaxed);
+        if (n != 0) {
+          res.flushLatency.addBucket(i, n);
+        }
+      }
+      res.flushLatency.addTotals(s.flushNanos.load(std::memory_order_relaxed),
+                                 s.flushMaxNanos.load(std::memory_order_relaxed));
+    }
+    return res;
+  }
+};
+
+// writes snapshot() as JSON to path every interval and once more on
+// destruction, through a temp file + rename so readers never see half a file
+class StatsDumper {
+private:
+  std::function<StatsSnapshot()> snapshot;
+  std::string path;
+  std::chrono::milliseconds interval;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  std::thread thread;
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+      wake.wait_for(lock, interval, [this] { return stopping; });
+      lock.unlock();
+      dump();
+      lock.lock();
+    }
+  }
+
+public:
+  StatsDumper(std::function<StatsSnapshot()> snapshot, const std::string &path,
+              std::chrono::milliseconds interval)
+      : snapshot(std::move(snapshot)), path(path), interval(interval),
+        thread(&StatsDumper::run, this) {}
+  ~StatsDumper() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+  }
+  void dump() {
+    Json json;
+    std::string tmp = path + ".tmp";
+    json.writeToFile(tmp, snapshot().toJson());
+    std::rename(tmp.c_str(), path.c_str());
+  }
+};
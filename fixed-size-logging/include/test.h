@@ -1,10 +1,22 @@
+#include "alloc_counter.h"
+#include "histogram.h"
+#include "log_reader.h"
+#include "message_arena.h"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <random>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 
 class Timer {
 private:
@@ -21,38 +33,101 @@ public:
   }
 };
 
+// serializes writes so single threaded loggers can be shared
+template <typename T> class LockedLogger {
+private:
+  T logger;
+  std::mutex mutex;
+
+public:
+  LockedLogger(const std::string &filename, std::size_t maxFileSize)
+      : logger(filename, maxFileSize) {}
+  void write(std::string_view data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    logger.write(data);
+  }
+};
+
+struct ContentionResult {
+  int threads;
+  double msgsPerSec;
+  double mbPerSec;
+  LatencyHistogram latency;
+};
+
 class Tester {
 public:
-  std::vector<std::string> generateMessage(int numMessages = 1, int minLen = 1,
-                                           int maxLen = 1000) {
+  // messages are stored back to back in arena, which must outlive the views
+  std::vector<std::string_view> generateMessage(MessageArena &arena,
+                                                int numMessages = 1,
+                                                int minLen = 1,
+                                                int maxLen = 1000) {
     static const std::string charset = "abcdefghijklmnopqrstuvwxyz"
                                        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
                                        "0123456789";
     static std::mt19937 rng(std::random_device{}());
     std::uniform_int_distribution<int> lengthDist(minLen, maxLen);
     std::uniform_int_distribution<int> charDist(0, charset.size() - 1);
-    std::vector<std::string> results;
+    std::vector<std::string_view> results;
     results.reserve(numMessages);
     for (int i = 0; i < numMessages; i++) {
       int length = lengthDist(rng);
-      std::string str;
-      str.reserve(length);
+      char *str = arena.allocate(length);
       for (int j = 0; j < length-1; j++) {
-        str.push_back(charset[charDist(rng)]);
+        str[j] = charset[charDist(rng)];
       }
-      str.push_back('\n');
-      results.push_back(std::move(str));
+      str[length - 1] = '\n';
+      results.emplace_back(str, length);
+    }
+    return results;
+  }
+
+  // repetitive lines closer to real service logs than generateMessage
+  std::vector<std::string_view> generateLogLines(MessageArena &arena,
+                                                 int numMessages = 1) {
+    static const char *levels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+    static const char *paths[] = {"/api/v1/users", "/api/v1/orders",
+                                  "/api/v1/search", "/healthz", "/metrics"};
+    static std::mt19937 rng(std::random_device{}());
+    std::uniform_int_distribution<int> levelDist(0, 5);
+    std::uniform_int_distribution<int> pathDist(0, 4);
+    std::uniform_int_distribution<int> idDist(0, 99999);
+    std::uniform_int_distribution<int> latencyDist(1, 250);
+    std::vector<std::string_view> results;
+    results.reserve(numMessages);
+    for (int i = 0; i < numMessages; i++) {
+      int ms = i * 7;
+      std::ostringstream line;
+      line << "2024-05-01T12:" << std::setfill('0') << std::setw(2)
+           << (ms / 60000) % 60 << ":" << std::setw(2) << (ms / 1000) % 60
+           << "." << std::setw(3) << ms % 1000 << "Z " << levels[levelDist(rng)]
+           << " [worker-" << i % 8 << "] request_id=" << std::setw(5)
+           << idDist(rng) << " path=" << paths[pathDist(rng)] << "/"
+           << idDist(rng) << " status=200 latency_ms=" << latencyDist(rng)
+           << "\n";
+      results.push_back(arena.add(line.str()));
     }
     return results;
   }
 
   template <typename T>
-  void runLogger(T obj, std::vector<std::string> &messages) {
+  void runLogger(T obj, std::vector<std::string_view> &messages) {
     for (size_t i = 0; i < messages.size(); i++) {
       obj.write(messages.at(i));
     }
   }
 
+  // heap allocations per write() call, construction and the final flush in
+  // the destructor are not counted
+  template <typename T>
+  double allocationsPerMessage(T obj, std::vector<std::string_view> &messages) {
+    std::uint64_t before = alloc::allocations();
+    for (size_t i = 0; i < messages.size(); i++) {
+      obj.write(messages.at(i));
+    }
+    return double(alloc::allocations() - before) / messages.size();
+  }
+
   template <typename Func, typename Setup = std::function<void()>>
   double benchmark(const std::string &name, Func func, int iterations = 1) {
     Timer timer;
@@ -73,6 +148,193 @@ public:
     return elapsed;
   }
 
+  // every thread writes all messages (starting at a different offset) into
+  // one shared logger, timing each write() call individually
+  template <typename T, typename Factory>
+  ContentionResult contentionBenchmark(const std::string &name, Factory make,
+                                       std::vector<std::string_view> &messages,
+                                       int numThreads) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<LatencyHistogram> latencies(numThreads);
+    std::vector<double> elapsed(numThreads);
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    std::size_t bytes = 0;
+    for (std::string_view message : messages) {
+      bytes += message.size();
+    }
+    std::cout << "============================================\n";
+    std::cout << "Contention: " << name << " (" << numThreads << " threads)\n";
+    {
+      std::unique_ptr<T> logger = make();
+      std::vector<std::thread> threads;
+      for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t]() {
+          LatencyHistogram &hist = latencies[t];
+          std::size_t n = messages.size();
+          std::size_t offset = n * t / numThreads;
+          ready.fetch_add(1);
+          while (!go.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+          }
+          Clock::time_point begin = Clock::now();
+          for (std::size_t i = 0; i < n; i++) {
+            std::string_view message = messages[(offset + i) % n];
+            Clock::time_point before = Clock::now();
+            logger->write(message);
+            Clock::time_point after = Clock::now();
+            hist.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            after - before)
+                            .count());
+          }
+          elapsed[t] = std::chrono::duration<double>(Clock::now() - begin).count();
+        });
+      }
+      while (ready.load() < numThreads) {
+        std::this_thread::yield();
+      }
+      go.store(true, std::memory_order_release);
+      for (std::thread &thread : threads) {
+        thread.join();
+      }
+    }
+    ContentionResult res{numThreads, 0.0, 0.0, LatencyHistogram()};
+    double slowest = 0.0;
+    std::cout << std::fixed << std::setprecision(1);
+    for (int t = 0; t < numThreads; t++) {
+      double msgs = messages.size() / elapsed[t];
+      double mb = bytes / elapsed[t] / (1024.0 * 1024.0);
+      std::cout << " - thread " << t << ": " << msgs << " msgs/s, " << mb
+                << " MB/s\n";
+      res.latency.merge(latencies[t]);
+      slowest = std::max(slowest, elapsed[t]);
+    }
+    res.msgsPerSec = messages.size() * numThreads / slowest;
+    res.mbPerSec = bytes * numThreads / slowest / (1024.0 * 1024.0);
+    std::cout << " - total: " << res.msgsPerSec << " msgs/s, " << res.mbPerSec
+              << " MB/s\n";
+    std::cout << " - write() latency: p50 " << res.latency.percentile(50)
+              << " ns, p99 " << res.latency.percentile(99) << " ns, p99.9 "
+              << res.latency.percentile(99.9) << " ns, max "
+              << res.latency.max() << " ns\n";
+    std::cout << "============================================\n";
+    return res;
+  }
+
+  // runs contentionBenchmark for 1, 2, 4 ... maxThreads producers and prints
+  // the scaling curve
+  template <typename T, typename Factory>
+  std::vector<ContentionResult>
+  contentionSweep(const std::string &name, Factory make,
+                  std::vector<std::string_view> &messages, int maxThreads) {
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+      threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+    std::vector<ContentionResult> results;
+    for (int threads : threadCounts) {
+      results.push_back(contentionBenchmark<T>(name, make, messages, threads));
+    }
+    std::cout << "Scaling: " << name << "\n";
+    std::cout << std::setw(8) << "threads" << std::setw(14) << "msgs/s"
+              << std::setw(10) << "MB/s" << std::setw(10) << "p50 ns"
+              << std::setw(10) << "p99 ns" << std::setw(12) << "p99.9 ns\n";
+    for (const ContentionResult &r : results) {
+      std::cout << std::setw(8) << r.threads << std::setw(14) << r.msgsPerSec
+                << std::setw(10) << r.mbPerSec << std::setw(10)
+                << r.latency.percentile(50) << std::setw(10)
+                << r.latency.percentile(99) << std::setw(11)
+                << r.latency.percentile(99.9) << "\n";
+    }
+    return results;
+  }
+
+  // for loggers that keep a different amount of history than the reference:
+  // passes if the shorter file is exactly the tail of the longer one and
+  // not empty, an exporter that writes nothing must not pass
+  bool checkTail(const std::string &_f1, const std::string &_f2) {
+    std::ifstream f1(_f1);
+    std::ifstream f2(_f2);
+    if (!f1 || !f2) {
+      std::cerr
+          << "Failed to open one or both files while checking accuracy.\n";
+      std::cout << " - Accuracy: FAIL\n";
+      return false;
+    }
+    std::ostringstream ss1, ss2;
+    ss1 << f1.rdbuf();
+    ss2 << f2.rdbuf();
+    std::string s1 = ss1.str();
+    std::string s2 = ss2.str();
+    const std::string &shorter = s1.size() < s2.size() ? s1 : s2;
+    const std::string &longer = s1.size() < s2.size() ? s2 : s1;
+    if (!shorter.empty() &&
+        longer.compare(longer.size() - shorter.size(), shorter.size(),
+                       shorter) == 0) {
+      std::cout << " - Accuracy: PASS\n";
+      return true;
+    } else {
+      std::cout << " - Accuracy: FAIL\n";
+      return false;
+    }
+  }
+
+  // reads a Logger4<..., SeekIndex<>> log written from messages (one line
+  // each, written once) back through LogReader
+  bool checkReader(const std::string &file, std::vector<std::string_view> &messages) {
+    LogReader reader(file);
+    std::string_view text = reader.text();
+    auto lines = [](std::string_view s) {
+      return static_cast<std::size_t>(std::count(s.begin(), s.end(), '\n'));
+    };
+    std::size_t retained = lines(text);
+    std::size_t first = messages.size() - retained; // first retained message
+    // tail: the last n messages, exactly
+    std::size_t n = std::min<std::size_t>(100, retained);
+    std::string expected;
+    for (std::size_t i = messages.size() - n; i < messages.size(); i++) {
+      expected += messages[i];
+    }
+    std::string_view last = reader.tail(100);
+    bool tailOk = lines(last) == n && last == expected;
+    // range: the slice around each entry's time holds the entry's record and
+    // starts on a record boundary, an unbounded range is the whole log
+    bool rangeOk = reader.range(INT64_MIN, INT64_MAX) == text &&
+                   reader.since(std::chrono::hours(1)) == text;
+    for (const SeekEntry &e : reader.index()) {
+      std::string_view r = reader.range(e.timeNs, e.timeNs);
+      std::size_t begin = r.data() - text.data();
+      std::size_t from = first + lines(text.substr(0, begin));
+      bool aligned = begin == 0 || text[begin - 1] == '\n';
+      rangeOk = rangeOk && aligned && from <= e.records && e.records < from + lines(r);
+    }
+    // search: same lines as a plain scan, in the whole log and in the tail
+    std::string_view probe = messages.back().substr(0, std::min<std::size_t>(6, messages.back().size() - 1));
+    auto scan = [&](std::string_view region) {
+      std::size_t count = 0;
+      for (std::size_t pos = 0; pos < region.size();) {
+        std::size_t end = region.find('\n', pos);
+        end = end == std::string_view::npos ? region.size() : end;
+        count += region.substr(pos, end - pos).find(probe) != std::string_view::npos;
+        pos = end + 1;
+      }
+      return count;
+    };
+    std::size_t found = 0;
+    bool searchOk = true;
+    reader.search(probe, [&](std::string_view line) {
+      found++;
+      searchOk = searchOk && line.find(probe) != std::string_view::npos;
+    });
+    searchOk = searchOk && found == scan(text) && found > 0 &&
+               reader.search(probe, [](std::string_view) {}, last) == scan(last);
+    std::cout << " - Seek index: " << reader.index().size() << " entries, tail "
+              << (tailOk ? "PASS" : "FAIL") << ", range " << (rangeOk ? "PASS" : "FAIL")
+              << ", search " << (searchOk ? "PASS" : "FAIL") << "\n";
+    return tailOk && rangeOk && searchOk;
+  }
+
   bool checkAccuracy(const std::string &_f1, const std::string &_f2) {
     std::ifstream f1(_f1);
     std::ifstream f2(_f2);
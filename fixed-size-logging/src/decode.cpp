@@ -0,0 +1,23 @@
+#include "binary_logger.h"
+#include <iostream>
+
+// prints a BinaryLogger file as text, expects "<file>.fmt" next to it
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "Requires a binary log file\n";
+    return 1;
+  }
+  try {
+    BinaryLogDecoder decoder(argv[1]);
+    std::string line;
+    while (decoder.next(line)) {
+      std::cout << line;
+      line.clear();
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
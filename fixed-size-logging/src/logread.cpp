@@ -0,0 +1,56 @@
+#include "log_reader.h"
+#include <iostream>
+
+// reads a Logger4 log through its seek index ("<file>.idx")
+//
+//   logread <file> tail [n]
+//   logread <file> since <age>           age like 30s, 5m, 2h, 1d
+//   logread <file> range <from> <to>     milliseconds since the epoch
+//   logread <file> grep <text> [age]     only the last age when given
+
+std::chrono::nanoseconds parseAge(const std::string &s) {
+  std::size_t used = 0;
+  long long n = std::stoll(s, &used);
+  std::string unit = s.substr(used);
+  if (unit.empty() || unit == "s") {
+    return std::chrono::seconds(n);
+  } else if (unit == "m") {
+    return std::chrono::minutes(n);
+  } else if (unit == "h") {
+    return std::chrono::hours(n);
+  } else if (unit == "d") {
+    return std::chrono::hours(24 * n);
+  }
+  throw std::runtime_error("Unknown age unit: " + unit);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cerr << "Usage: logread <file> tail [n] | since <age> | range <from_ms> <to_ms> | "
+                 "grep <text> [age]\n";
+    return 1;
+  }
+  try {
+    LogReader reader(argv[1]);
+    std::string command = argv[2];
+    if (command == "tail") {
+      std::cout << reader.tail(argc > 3 ? std::stoul(argv[3]) : 10);
+    } else if (command == "since" && argc > 3) {
+      std::cout << reader.since(parseAge(argv[3]));
+    } else if (command == "range" && argc > 4) {
+      std::int64_t ms = 1000000;
+      std::cout << reader.range(std::stoll(argv[3]) * ms, std::stoll(argv[4]) * ms);
+    } else if (command == "grep" && argc > 3) {
+      std::string_view region = argc > 4 ? reader.since(parseAge(argv[4])) : reader.text();
+      reader.search(
+          argv[3], [](std::string_view line) { std::cout << line << '\n'; }, region);
+    } else {
+      std::cerr << "Unknown command: " << command << "\n";
+      return 1;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
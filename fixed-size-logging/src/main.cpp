@@ -1,18 +1,99 @@
+#include "async_logger.h"
+#include "binary_logger.h"
 #include "logger1.h"
 #include "logger2.h"
 #include "logger3.h"
 #include "logger4.h"
+#include "logger5.h"
+#include "logger6.h"
+#include "logger7.h"
+#include "logger8.h"
+#include "logger9.h"
+#include "stats.h"
 #include "test.h"
+#include <cstdlib>
 #include <cstring>
+#include <filesystem>
+#include <new>
+
+// count every heap allocation for allocationReport, the aligned forms are
+// used by the cache line aligned cells and counters
+void *operator new(std::size_t size) {
+  alloc::count.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void *operator new(std::size_t size, std::align_val_t align) {
+  alloc::count.fetch_add(1, std::memory_order_relaxed);
+  std::size_t alignment = static_cast<std::size_t>(align);
+  if (void *p = std::aligned_alloc(
+          alignment, (size + alignment - 1) / alignment * alignment)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
 
 struct Args {
   int numIterations = 100;
   int numMessages = 1000;
   int maxFileSize = 1024; // 1KB
   std::string fileName = "log";
+  int maxThreads = 0; // contention sweep is skipped unless this is set
 };
 
-void fullBenchmark(Tester t, Args a, std::vector<std::string> &messages) {
+// Logger8 against Logger4 on random messages and on repetitive log lines,
+// retained history is reported relative to the cap
+void compressionBenchmark(Tester t, Args a, std::vector<std::string_view> &messages) {
+  MessageArena arena;
+  std::vector<std::string_view> lines = t.generateLogLines(arena, a.numMessages);
+  {
+    Logger3 logger("comp_lines", a.maxFileSize);
+    for (std::size_t i = 0; i < lines.size(); i++) {
+      logger.write(lines.at(i));
+    }
+  }
+  auto report = [&](const std::string &file) {
+    Logger8Reader reader(file);
+    std::cout << " - Retained history: " << reader.read().size() << " bytes ("
+              << std::setprecision(2)
+              << double(reader.read().size()) / a.maxFileSize << "x of cap)\n"
+              << std::setprecision(3);
+    reader.exportTo(a.fileName);
+  };
+  t.benchmark(
+      "Compressed Implementation (random)",
+      [&]() { t.runLogger<Logger8>(Logger8("lz", a.maxFileSize), messages); },
+      a.numIterations);
+  report("lz");
+  if (!t.checkTail("log", "comp")) {
+    std::cerr << "Logger 8 failed accuracy check\n";
+    return;
+  }
+  t.benchmark(
+      "Raw Dawg Implementation (log lines)",
+      [&]() { t.runLogger<Logger4<>>(Logger4<>(a.fileName, a.maxFileSize), lines); },
+      a.numIterations);
+  std::cout << " - Retained history: 1.00x of cap\n";
+  t.benchmark(
+      "Compressed Implementation (log lines)",
+      [&]() { t.runLogger<Logger8>(Logger8("lz", a.maxFileSize), lines); },
+      a.numIterations);
+  report("lz");
+  if (!t.checkTail("log", "comp_lines")) {
+    std::cerr << "Logger 8 failed accuracy check on log lines\n";
+    return;
+  }
+}
+
+void fullBenchmark(Tester t, Args a, std::vector<std::string_view> &messages) {
   t.benchmark(
       "Naive Implementation",
       [&]() { t.runLogger<Logger1>(Logger1(a.fileName, a.maxFileSize), messages); },
@@ -39,28 +120,294 @@ void fullBenchmark(Tester t, Args a, std::vector<std::string> &messages) {
   }
   t.benchmark(
       "Raw Dawg Implementation",
-      [&]() { t.runLogger<Logger4>(Logger4(a.fileName, a.maxFileSize), messages); },
+      [&]() { t.runLogger<Logger4<>>(Logger4<>(a.fileName, a.maxFileSize), messages); },
       a.numIterations);
   if (!t.checkAccuracy("log", "comp")) {
     std::cerr << "Logger 4 failed accuracy check\n";
     return;
   }
+  t.benchmark(
+      "Raw Dawg Implementation (stats)",
+      [&]() {
+        t.runLogger<Logger4<LoggerStats>>(
+            Logger4<LoggerStats>(a.fileName, a.maxFileSize), messages);
+      },
+      a.numIterations);
+  if (!t.checkAccuracy("log", "comp")) {
+    std::cerr << "Logger 4 (stats) failed accuracy check\n";
+    return;
+  }
+  StatsSnapshot stats;
+  {
+    Logger4<LoggerStats> logger(a.fileName, a.maxFileSize);
+    StatsDumper dumper([&]() { return logger.stats(); }, "stats.json",
+                       std::chrono::milliseconds(100));
+    for (std::string_view message : messages) {
+      logger.write(message);
+    }
+    logger.flush();
+    stats = logger.stats();
+    std::cout << " - " << stats.flushes << " flushes, " << stats.wraps
+              << " wraps, " << stats.shiftedBytes / 1024 << "KB shifted, "
+              << stats.droppedBytes / 1024 << "KB aged out, p99 flush "
+              << stats.flushLatency.percentile(99) / 1000 << "us (stats.json)\n";
+  }
+  // everything written is either in the file or was aged out of it
+  if (stats.bytes - stats.droppedBytes != std::filesystem::file_size(a.fileName)) {
+    std::cerr << "Logger 4 (stats) dropped bytes do not add up\n";
+    return;
+  }
+  t.benchmark(
+      "Raw Dawg Implementation (seek index)",
+      [&]() {
+        // a 4KB interval so small caps still get several entries
+        using IndexedLogger = Logger4<NoStats, SeekIndex<4>>;
+        t.runLogger<IndexedLogger>(IndexedLogger(a.fileName, a.maxFileSize), messages);
+      },
+      a.numIterations);
+  if (!t.checkAccuracy("log", "comp") || !t.checkReader(a.fileName, messages)) {
+    std::cerr << "Logger 4 (seek index) failed accuracy check\n";
+    return;
+  }
+  t.benchmark(
+      "Ring Buffer Implementation",
+      [&]() { t.runLogger<Logger5>(Logger5("ring", a.maxFileSize), messages); },
+      a.numIterations);
+  Logger5::exportTo("ring", a.fileName);
+  if (!t.checkAccuracy("log", "comp")) {
+    std::cerr << "Logger 5 failed accuracy check\n";
+    return;
+  }
+  t.benchmark(
+      "Async Implementation",
+      [&]() {
+        t.runLogger<AsyncLogger<>>(AsyncLogger<>(a.fileName, a.maxFileSize),
+                                   messages);
+      },
+      a.numIterations);
+  if (!t.checkAccuracy("log", "comp")) {
+    std::cerr << "Async logger failed accuracy check\n";
+    return;
+  }
+  t.benchmark(
+      "Double Buffered Implementation (fstream)",
+      [&]() {
+        t.runLogger<Logger6<>>(Logger6<>(a.fileName, a.maxFileSize), messages);
+      },
+      a.numIterations);
+  if (!t.checkAccuracy("log", "comp")) {
+    std::cerr << "Logger 6 (fstream) failed accuracy check\n";
+    return;
+  }
+  t.benchmark(
+      "Double Buffered Implementation (aio)",
+      [&]() {
+        t.runLogger<Logger6<PosixAioBackend<>>>(
+            Logger6<PosixAioBackend<>>(a.fileName, a.maxFileSize), messages);
+      },
+      a.numIterations);
+  if (!t.checkAccuracy("log", "comp")) {
+    std::cerr << "Logger 6 (aio) failed accuracy check\n";
+    return;
+  }
+  t.benchmark(
+      "Double Buffered Implementation (aio + O_DIRECT)",
+      [&]() {
+        t.runLogger<Logger6<PosixAioBackend<true>>>(
+            Logger6<PosixAioBackend<true>>(a.fileName, a.maxFileSize), messages);
+      },
+      a.numIterations);
+  if (!t.checkAccuracy("log", "comp")) {
+    std::cerr << "Logger 6 (aio + O_DIRECT) failed accuracy check\n";
+    return;
+  }
+  t.benchmark(
+      "Segmented Implementation",
+      [&]() { t.runLogger<Logger7>(Logger7("seg", a.maxFileSize), messages); },
+      a.numIterations);
+  Logger7Reader("seg").exportTo(a.fileName);
+  if (!t.checkAccuracy("log", "comp")) {
+    std::cerr << "Logger 7 failed accuracy check\n";
+    return;
+  }
+  compressionBenchmark(t, a, messages);
+  t.benchmark(
+      "Crash Safe Implementation",
+      [&]() { t.runLogger<Logger9>(Logger9("wal", a.maxFileSize), messages); },
+      a.numIterations);
+  Logger9::exportTo("wal", a.fileName);
+  if (!t.checkTail("log", "comp")) {
+    std::cerr << "Logger 9 failed accuracy check\n";
+    return;
+  }
+  t.benchmark(
+      "Crash Safe Implementation (fsync every 100ms)",
+      [&]() {
+        t.runLogger<Logger9>(Logger9("wal", a.maxFileSize, FsyncPolicy::Interval,
+                                     std::chrono::milliseconds(100)),
+                             messages);
+      },
+      a.numIterations);
+  Logger9::exportTo("wal", a.fileName);
+  if (!t.checkTail("log", "comp")) {
+    std::cerr << "Logger 9 (fsync every 100ms) failed accuracy check\n";
+    return;
+  }
+  // a cap below the 8KB write batch
+  t.benchmark(
+      "Crash Safe Implementation (2KB cap)",
+      [&]() { t.runLogger<Logger9>(Logger9("wal", 2048), messages); },
+      a.numIterations);
+  Logger9::exportTo("wal", a.fileName);
+  if (!t.checkTail("log", "comp")) {
+    std::cerr << "Logger 9 (2KB cap) failed accuracy check\n";
+    return;
+  }
+  // same payload as the text loggers plus two numeric fields, formatting
+  // into text is deferred to build/decode
+  t.benchmark(
+      "Binary Implementation",
+      [&]() {
+        BinaryLogger logger("binlog", a.maxFileSize);
+        for (std::size_t i = 0; i < messages.size(); i++) {
+          BINLOG(logger, "[{}] {} bytes: {}", i, messages[i].size(), messages[i]);
+        }
+      },
+      a.numIterations);
+  {
+    // the decoded records and the formatted text end the same way
+    Logger3 formatted("comp_binlog", a.maxFileSize);
+    for (std::size_t i = 0; i < messages.size(); i++) {
+      formatted.write("[" + std::to_string(i) + "] " + std::to_string(messages[i].size()) +
+                      " bytes: " + std::string(messages[i]));
+    }
+    std::ofstream decoded("binlog.txt", std::ios::binary | std::ios::trunc);
+    decoded << BinaryLogDecoder("binlog").decode();
+  }
+  if (!t.checkTail("binlog.txt", "comp_binlog")) {
+    std::cerr << "Binary logger failed accuracy check\n";
+    return;
+  }
+  t.benchmark(
+      "Formatted Raw Dawg Implementation",
+      [&]() {
+        Logger4<> logger(a.fileName, a.maxFileSize);
+        for (std::size_t i = 0; i < messages.size(); i++) {
+          logger.write("[" + std::to_string(i) + "] " +
+                       std::to_string(messages[i].size()) +
+                       " bytes: " + std::string(messages[i]));
+        }
+      },
+      a.numIterations);
+}
+
+// heap allocations made by write() alone, should be 0 for every logger that
+// keeps its buffers across calls
+void allocationReport(Tester t, Args a, std::vector<std::string_view> &messages) {
+  std::cout << "============================================\n";
+  std::cout << "Allocations per message\n";
+  auto row = [&](const std::string &name, double perMessage) {
+    std::cout << " - " << std::left << std::setw(28) << name << std::right
+              << std::setprecision(3) << perMessage << "\n";
+  };
+  row("Naive", t.allocationsPerMessage(Logger1(a.fileName, a.maxFileSize), messages));
+  row("Buffer", t.allocationsPerMessage(Logger2(a.fileName, a.maxFileSize), messages));
+  row("2 Pointer", t.allocationsPerMessage(Logger3(a.fileName, a.maxFileSize), messages));
+  row("Raw Dawg", t.allocationsPerMessage(Logger4<>(a.fileName, a.maxFileSize), messages));
+  row("Ring Buffer", t.allocationsPerMessage(Logger5("ring", a.maxFileSize), messages));
+  row("Async", t.allocationsPerMessage(AsyncLogger<>(a.fileName, a.maxFileSize), messages));
+  row("Double Buffered (fstream)",
+      t.allocationsPerMessage(Logger6<>(a.fileName, a.maxFileSize), messages));
+  row("Segmented", t.allocationsPerMessage(Logger7("seg", a.maxFileSize), messages));
+  row("Compressed", t.allocationsPerMessage(Logger8("lz", a.maxFileSize), messages));
+  row("Crash Safe", t.allocationsPerMessage(Logger9("wal", a.maxFileSize), messages));
+  std::cout << "============================================\n";
+}
+
+// fills a Logger9 log past its cap, abandons it the way a crashed process
+// would and times reopening it, for caps of 1MB, 4MB ... maxMegabytes
+void recoveryBenchmark(Tester t, int maxMegabytes) {
+  MessageArena arena;
+  std::vector<std::string_view> messages = t.generateMessage(arena, 1000);
+  for (std::size_t cap = 1 << 20; cap <= (std::size_t(maxMegabytes) << 20);
+       cap *= 4) {
+    std::size_t count = 0;
+    {
+      Logger9 logger("wal", cap);
+      std::size_t written = 0;
+      for (; written < cap + cap / 2; count++) {
+        std::string_view message = messages[count % messages.size()];
+        logger.write(message);
+        written += message.size();
+      }
+      logger.flush();
+      logger.abandon();
+    }
+    std::uint64_t retained = 0;
+    t.benchmark(
+        "Recovery (" + std::to_string(cap >> 20) + " MB cap)",
+        [&]() {
+          Logger9 logger("wal", cap);
+          retained = logger.retainedBytes();
+        },
+        1);
+    std::cout << " - Recovered: " << retained << " bytes\n";
+    // the recovered payloads must be the last messages written, whole
+    Logger9::exportTo("wal", "comp_wal");
+    std::ifstream in("comp_wal", std::ios::binary);
+    std::string recovered((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    bool ok = !recovered.empty();
+    for (std::size_t end = recovered.size(), i = count; ok && end > 0; i--) {
+      std::string_view message = messages[(i - 1) % messages.size()];
+      ok = i > 0 && message.size() <= end &&
+           recovered.compare(end - message.size(), message.size(), message) == 0;
+      end -= std::min(end, message.size());
+    }
+    std::cout << " - Accuracy: " << (ok ? "PASS" : "FAIL") << "\n";
+  }
+}
+
+void contentionBenchmark(Tester t, Args a, std::vector<std::string_view> &messages) {
+  t.contentionSweep<LockedLogger<Logger4<>>>(
+      "Raw Dawg Implementation (mutex)",
+      [&]() {
+        return std::make_unique<LockedLogger<Logger4<>>>(a.fileName, a.maxFileSize);
+      },
+      messages, a.maxThreads);
+  t.contentionSweep<LockedLogger<Logger5>>(
+      "Ring Buffer Implementation (mutex)",
+      [&]() {
+        return std::make_unique<LockedLogger<Logger5>>("ring", a.maxFileSize);
+      },
+      messages, a.maxThreads);
+  t.contentionSweep<AsyncLogger<>>(
+      "Async Implementation",
+      [&]() { return std::make_unique<AsyncLogger<>>(a.fileName, a.maxFileSize); },
+      messages, a.maxThreads);
 }
 
 int main(int argc, char *argv[]) {
   Tester t;
   Args a;
 
+  if (argc > 1 && std::strcmp(argv[1], "recovery") == 0) {
+    recoveryBenchmark(t, argc > 2 ? atoi(argv[2]) : 1024);
+    return 0;
+  }
   if (argc < 3) {
     std::cerr << "Requires num messages and max file size\n";
     return 1;
   }
   a.numMessages = atoi(argv[1]);
   a.maxFileSize = 1024 * atoi(argv[2]);
+  if (argc > 3) {
+    a.maxThreads = atoi(argv[3]);
+  }
 
-  std::vector<std::string> messages;
+  MessageArena arena;
+  std::vector<std::string_view> messages;
   t.benchmark("Generating Messages", [&]() {
-    messages = t.generateMessage(a.numMessages);
+    messages = t.generateMessage(arena, a.numMessages);
   }, 1);
 
   t.benchmark("Generating File Comp", [&]() {
@@ -70,7 +417,13 @@ int main(int argc, char *argv[]) {
     }
   }, 1);
 
+  if (a.maxThreads > 0) {
+    contentionBenchmark(t, a, messages);
+    return 0;
+  }
+
   fullBenchmark(t, a, messages);
+  allocationReport(t, a, messages);
 
   return 0;
 }
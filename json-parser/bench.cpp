@@ -0,0 +1,662 @@
+#include "json.h"
+#include "json_cbor.h"
+#include "json_ndjson.h"
+#include "json_ondemand.h"
+#include "json_path.h"
+#include "json_sax.h"
+#include "json_simd.h"
+#include "json_tape.h"
+#include "json_writer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// parse, serialize and round trip throughput over synthetic corpora
+//
+//     bench [size per corpus, e.g. 64K 16M 1G] [output prefix] [max threads]
+//
+// every corpus is a list of documents of about the same total size. each
+// measurement repeats until it has run for a quarter second and reports
+// MB/s, documents/s, peak RSS during the run and heap allocations per
+// document. results go to <prefix>.json and <prefix>.csv as well as stdout.
+
+namespace alloc {
+
+inline std::atomic<uint64_t> count{0};
+
+inline uint64_t allocations() { return count.load(std::memory_order_relaxed); }
+
+} // namespace alloc
+
+void* operator new(std::size_t size) {
+    alloc::count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+// kept out of line, gcc warns about free on memory from operator new once
+// these are inlined at -O2
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+class Timer {
+private:
+    std::chrono::high_resolution_clock::time_point start_time;
+
+public:
+    void start() { start_time = std::chrono::high_resolution_clock::now(); }
+
+    double elapsed_ms() {
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+            end_time - start_time);
+        return duration.count() / 1000.0; // milliseconds
+    }
+};
+
+struct Corpus {
+    std::string name;
+    std::vector<std::string> docs;
+    size_t bytes = 0;
+
+    void add(std::string doc) {
+        bytes += doc.size();
+        docs.push_back(std::move(doc));
+    }
+};
+
+struct Result {
+    std::string corpus;
+    std::string operation;
+    std::string parser;
+    size_t bytes;
+    size_t docs;
+    double seconds;
+    long peakRssKb;
+    double allocsPerDoc;
+};
+
+// peak RSS since the last reset, the reset needs Linux 4.0, otherwise this
+// is the peak of the whole process
+long peakRssKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::atol(line.c_str() + 6);
+        }
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void resetPeakRss() {
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+}
+
+class Tester {
+private:
+    std::vector<Result> results;
+
+public:
+    static constexpr double MIN_MS = 250;
+
+    // func() processes bytes of input in some number of documents and
+    // returns that number, it runs until MIN_MS have passed
+    template <typename Func>
+    const Result& benchmark(const std::string& corpus, const std::string& operation,
+                            const std::string& parser, size_t bytes, Func func) {
+        resetPeakRss();
+        uint64_t allocsBefore = alloc::allocations();
+        Timer timer;
+        timer.start();
+        size_t docs = 0;
+        size_t iterations = 0;
+        double elapsed;
+        do {
+            docs += func();
+            iterations++;
+            elapsed = timer.elapsed_ms();
+        } while (elapsed < MIN_MS);
+        Result r{corpus, operation, parser, bytes * iterations, docs, elapsed / 1000.0, peakRssKb(),
+                 double(alloc::allocations() - allocsBefore) / std::max<size_t>(docs, 1)};
+        std::cout << std::fixed << std::setprecision(1) << std::left << std::setw(10) << r.corpus
+                  << std::setw(12) << r.operation << std::setw(22) << r.parser << std::right
+                  << std::setw(10) << r.bytes / r.seconds / (1024 * 1024) << std::setw(12)
+                  << std::setprecision(0) << r.docs / r.seconds << std::setw(12) << r.peakRssKb
+                  << std::setw(12) << std::setprecision(2) << r.allocsPerDoc << "\n";
+        results.push_back(r);
+        return results.back();
+    }
+
+    void header() {
+        std::cout << std::left << std::setw(10) << "corpus" << std::setw(12) << "operation"
+                  << std::setw(22) << "parser" << std::right << std::setw(10) << "MB/s"
+                  << std::setw(12) << "docs/s" << std::setw(12) << "peak RSS KB"
+                  << std::setw(12) << "allocs/doc" << "\n";
+    }
+
+    // one JSON file and one CSV file with a row per measurement
+    void write(const std::string& prefix, const std::string& size) {
+        int fd = ::open((prefix + ".json").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Unable to open file");
+        }
+        {
+            FdSink sink(fd);
+            JsonWriter<FdSink> out(sink, true);
+            out.startObject();
+            out.key("size");
+            out.string(size);
+            out.key("results");
+            out.startArray();
+            for (const Result& r : results) {
+                out.startObject();
+                out.key("corpus"); out.string(r.corpus);
+                out.key("operation"); out.string(r.operation);
+                out.key("parser"); out.string(r.parser);
+                out.key("bytes"); out.number(uint64_t(r.bytes));
+                out.key("docs"); out.number(uint64_t(r.docs));
+                out.key("seconds"); out.number(r.seconds);
+                out.key("mb_per_s"); out.number(r.bytes / r.seconds / (1024 * 1024));
+                out.key("docs_per_s"); out.number(r.docs / r.seconds);
+                out.key("peak_rss_kb"); out.number(int64_t(r.peakRssKb));
+                out.key("allocs_per_doc"); out.number(r.allocsPerDoc);
+                out.endObject();
+            }
+            out.endArray();
+            out.endObject();
+            sink.put('\n');
+            sink.flush();
+        }
+        ::close(fd);
+        std::ofstream csv(prefix + ".csv");
+        csv << "corpus,operation,parser,bytes,docs,seconds,mb_per_s,docs_per_s,peak_rss_kb,allocs_per_doc\n";
+        for (const Result& r : results) {
+            csv << r.corpus << "," << r.operation << "," << r.parser << "," << r.bytes << ","
+                << r.docs << "," << r.seconds << "," << r.bytes / r.seconds / (1024 * 1024) << ","
+                << r.docs / r.seconds << "," << r.peakRssKb << "," << r.allocsPerDoc << "\n";
+        }
+    }
+};
+
+// corpora, each about totalBytes split into documents of about docBytes
+
+// integers, decimals, negatives and exponents, as in metrics payloads
+Corpus generateNumbers(size_t totalBytes, size_t docBytes = 64 * 1024) {
+    std::mt19937_64 rng(1);
+    Corpus c{"numbers"};
+    while (c.bytes < totalBytes) {
+        std::string doc = "[";
+        while (doc.size() < docBytes) {
+            if (doc.size() > 1) {
+                doc += ',';
+            }
+            switch (rng() % 4) {
+                case 0: doc += std::to_string(int64_t(rng() % 2000000) - 1000000); break;
+                case 1: jsonnum::append(double(rng() % 100000000) / 997.0, doc); break;
+                case 2: jsonnum::append(double(int64_t(rng())) * 1e-300, doc); break;
+                default: doc += std::to_string(rng() % 1000); break;
+            }
+        }
+        c.add(doc + "]");
+    }
+    return c;
+}
+
+// strings with quotes, backslashes, control and \\u escapes (surrogate pairs
+// too) and UTF-8 text
+Corpus generateStrings(size_t totalBytes, size_t docBytes = 64 * 1024) {
+    static const char* pieces[] = {"plain text ", "\\\"quoted\\\" ", "back\\\\slash ", "tab\\there ",
+                                   "line\\nbreak ", "path\\/to ", "longer run of ordinary words ",
+                                   "caf\\u00e9 ", "smile \\ud83d\\ude00 ", "na\xc3\xafve r\xc3\xa9sum\xc3\xa9 ",
+                                   "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe3\x81\xae\xe3\x83\x86\xe3\x82\xad\xe3\x82\xb9\xe3\x83\x88 "};
+    std::mt19937 rng(2);
+    Corpus c{"strings"};
+    while (c.bytes < totalBytes) {
+        std::string doc = "{";
+        for (int k = 0; doc.size() < docBytes; k++) {
+            doc += (k ? ",\"key" : "\"key") + std::to_string(k) + "\":\"";
+            for (int n = rng() % 12; n >= 0; n--) {
+                doc += pieces[rng() % 11];
+            }
+            doc += '"';
+        }
+        c.add(doc + "}");
+    }
+    return c;
+}
+
+// arrays and objects nested depth levels deep
+Corpus generateNested(size_t totalBytes, int depth = 200) {
+    Corpus c{"nested"};
+    std::string doc;
+    for (int i = 0; i < depth; i++) {
+        doc += i % 2 ? "[1,\"x\"," : "{\"k\":true,\"v\":";
+    }
+    doc += "null";
+    for (int i = depth - 1; i >= 0; i--) {
+        doc += i % 2 ? "]" : "}";
+    }
+    while (c.bytes < totalBytes) {
+        c.add(doc);
+    }
+    return c;
+}
+
+// one object with numFields members of mixed types, a few of them nested
+std::string generateWideDocument(int numFields, int seed) {
+    std::mt19937 rng(seed);
+    std::string res = "{";
+    for (int i = 0; i < numFields; i++) {
+        res += (i ? ",\"field" : "\"field") + std::to_string(i) + "\":";
+        switch (i % 5) {
+            case 0: res += std::to_string(rng() % 100000); break;
+            case 1: res += std::to_string(rng() % 1000) + "." + std::to_string(rng() % 1000); break;
+            case 2: res += "\"value " + std::to_string(rng()) + " with \\\"quotes\\\"\""; break;
+            case 3: res += "[1,2,3,{\"x\":[4,5,6]},\"]\"]"; break;
+            default: res += "{\"a\":" + std::to_string(rng() % 100) + ",\"b\":{\"c\":true,\"d\":\"}\"}}"; break;
+        }
+    }
+    return res + "}";
+}
+
+Corpus generateWide(size_t totalBytes) {
+    Corpus c{"wide"};
+    for (int i = 0; c.bytes < totalBytes; i++) {
+        c.add(generateWideDocument(200, i % 64));
+    }
+    return c;
+}
+
+// event records like the ones in our NDJSON dumps, one document per line
+Corpus generateNdjson(size_t totalBytes) {
+    static const char* levels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+    std::mt19937 rng(42);
+    Corpus c{"ndjson"};
+    for (long long i = 0; c.bytes < totalBytes; i++) {
+        c.add("{\"ts\":" + std::to_string(1714564800000LL + i * 7) +
+              ",\"level\":\"" + levels[rng() % 6] +
+              "\",\"request_id\":\"" + std::to_string(rng()) +
+              "\",\"path\":\"/api/v1/users/" + std::to_string(rng() % 100000) +
+              "\",\"status\":200,\"latency_ms\":" + std::to_string(rng() % 250) +
+              "." + std::to_string(rng() % 100) +
+              ",\"tags\":[\"a\",\"b\"],\"ok\":true}\n");
+    }
+    return c;
+}
+
+struct CountingHandler : JsonSaxHandler {
+    size_t values = 0;
+    void string(std::string_view) { values++; }
+    void number(double) { values++; }
+    void boolean(bool) { values++; }
+    void null() { values++; }
+};
+
+// a fast parser that builds the wrong tree is not worth measuring
+[[noreturn]] void mismatch(const std::string& corpus, const std::string& what, size_t doc) {
+    std::cerr << corpus << ": " << what << " differs from Json on document " << doc << "\n";
+    std::exit(1);
+}
+
+// compact text of the SAX events for doc fed in chunks of chunkBytes
+std::string streamText(const std::string& doc, size_t chunkBytes) {
+    std::string out;
+    StringSink sink(out);
+    JsonWriter<StringSink> writer(sink);
+    JsonStreamParser<JsonWriter<StringSink>> parser(writer);
+    for (size_t i = 0; i < doc.size(); i += chunkBytes) {
+        parser.feed(std::string_view(doc).substr(i, chunkBytes));
+    }
+    parser.finish();
+    return out;
+}
+
+// every parser and the CBOR round trip must print what Json prints. the
+// stream parser also gets the first documents in small chunks, which
+// splits escapes, surrogate pairs and UTF-8 sequences between feeds
+void checkCorpus(const Corpus& c) {
+    Json json;
+    SimdJson simd;
+    jsonsimd::StructuralIndex index;
+    size_t splitBytes = 0;
+    for (size_t i = 0; i < c.docs.size(); i++) {
+        const std::string& doc = c.docs[i];
+        JsonValue value = json.parse(doc);
+        std::string expected = json.stringify(value, false);
+        if (json.stringify(simd.parse(doc), false) != expected) {
+            mismatch(c.name, "SimdJson", i);
+        }
+        if (json.stringify(JsonDocument::parse(doc, index).root().toValue(), false) != expected) {
+            mismatch(c.name, "JsonDocument", i);
+        }
+        if (json.stringify(jsoncbor::decode(jsoncbor::encode(value)), false) != expected) {
+            mismatch(c.name, "CBOR round trip", i);
+        }
+        if (streamText(doc, doc.size()) != expected) {
+            mismatch(c.name, "JsonStreamParser", i);
+        }
+        if (splitBytes < (256 << 10)) {
+            for (size_t chunk : {1, 3, 64}) {
+                if (streamText(doc, chunk) != expected) {
+                    mismatch(c.name, "JsonStreamParser in " + std::to_string(chunk) + " byte chunks", i);
+                }
+            }
+            splitBytes += doc.size();
+        }
+    }
+}
+
+// parse with every parser, serialize and round trip with Json
+void corpusBenchmarks(Tester& tester, const Corpus& c) {
+    checkCorpus(c);
+    Json json;
+    tester.benchmark(c.name, "parse", "Json", c.bytes, [&] {
+        for (const std::string& doc : c.docs) {
+            JsonValue v = json.parse(doc);
+        }
+        return c.docs.size();
+    });
+    SimdJson simd;
+    tester.benchmark(c.name, "parse", "SimdJson", c.bytes, [&] {
+        for (const std::string& doc : c.docs) {
+            JsonValue v = simd.parse(doc);
+        }
+        return c.docs.size();
+    });
+    jsonsimd::StructuralIndex index;
+    tester.benchmark(c.name, "parse", "JsonDocument", c.bytes, [&] {
+        for (const std::string& doc : c.docs) {
+            JsonDocument d = JsonDocument::parse(doc, index);
+        }
+        return c.docs.size();
+    });
+    tester.benchmark(c.name, "parse", "JsonStreamParser", c.bytes, [&] {
+        for (const std::string& doc : c.docs) {
+            CountingHandler handler;
+            JsonStreamParser<CountingHandler> parser(handler);
+            parser.feed(doc);
+            parser.finish();
+        }
+        return c.docs.size();
+    });
+
+    std::vector<JsonValue> values;
+    for (const std::string& doc : c.docs) {
+        values.push_back(json.parse(doc));
+    }
+    std::string out;
+    size_t compactBytes = 0;
+    for (const JsonValue& v : values) {
+        compactBytes += json.stringify(v, false).size();
+    }
+    tester.benchmark(c.name, "serialize", "JsonWriter", compactBytes, [&] {
+        for (const JsonValue& v : values) {
+            out.clear();
+            StringSink sink(out);
+            JsonWriter<StringSink> writer(sink);
+            Json::write(v, writer);
+        }
+        return values.size();
+    });
+    tester.benchmark(c.name, "serialize", "pretty", compactBytes, [&] {
+        for (const JsonValue& v : values) {
+            out = json.stringify(v);
+        }
+        return values.size();
+    });
+    tester.benchmark(c.name, "serialize", "CBOR", compactBytes, [&] {
+        for (const JsonValue& v : values) {
+            out.clear();
+            StringSink sink(out);
+            jsoncbor::encode(v, sink);
+        }
+        return values.size();
+    });
+    // MB/s of the JSON text the CBOR stands for, comparable with the parsers
+    std::vector<std::string> encoded;
+    for (const JsonValue& v : values) {
+        encoded.push_back(jsoncbor::encode(v));
+    }
+    tester.benchmark(c.name, "parse", "CBOR", c.bytes, [&] {
+        for (const std::string& bytes : encoded) {
+            JsonValue v = jsoncbor::decode(bytes);
+        }
+        return encoded.size();
+    });
+    tester.benchmark(c.name, "roundtrip", "Json", c.bytes, [&] {
+        for (const std::string& doc : c.docs) {
+            out = json.stringify(json.parse(doc), false);
+        }
+        return c.docs.size();
+    });
+}
+
+// records/s for 1, 2, 4 ... maxThreads workers over the joined lines. the
+// default 1 MiB chunks leave workers idle on small inputs, so chunks are
+// sized for about 8 per worker
+void ndjsonScaling(Tester& tester, const Corpus& c, int maxThreads) {
+    std::string input;
+    input.reserve(c.bytes);
+    for (const std::string& line : c.docs) {
+        input += line;
+    }
+    struct Point {
+        int threads;
+        double ordered;
+        double unordered;
+    };
+    std::vector<Point> points;
+    for (int threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+        size_t chunkBytes = std::max<size_t>(64 << 10, input.size() / (size_t(threads) * 8));
+        NdjsonParser parser(threads, chunkBytes);
+        std::string name = std::to_string(threads) + " threads";
+        const Result& ordered = tester.benchmark(c.name, "parse", "ordered " + name, input.size(), [&] {
+            return parser.parse(input, [](JsonDocument&) {});
+        });
+        double orderedRate = ordered.bytes / ordered.seconds;
+        const Result& unordered = tester.benchmark(c.name, "parse", "unordered " + name, input.size(), [&] {
+            return parser.parseUnordered(input, [](JsonDocument&) {});
+        });
+        points.push_back({threads, orderedRate, unordered.bytes / unordered.seconds});
+        if (threads == maxThreads) {
+            break;
+        }
+    }
+    std::cout << "ndjson scaling on " << std::thread::hardware_concurrency()
+              << " hardware threads, speedup over 1 thread (ordered / unordered)\n";
+    for (const Point& p : points) {
+        std::cout << std::setw(6) << p.threads << std::fixed << std::setprecision(2)
+                  << std::setw(8) << p.ordered / points[0].ordered << std::setw(8)
+                  << p.unordered / points[0].unordered << "\n";
+    }
+}
+
+// reads 5 of 200 fields per document: eager DOM, tape and on demand
+void wideFieldAccess(Tester& tester, const Corpus& c) {
+    double sum = 0;
+    Json json;
+    tester.benchmark(c.name, "5 fields", "Json", c.bytes, [&] {
+        for (const std::string& doc : c.docs) {
+            JsonValue v = json.parse(doc);
+            const JsonObject& obj = v.getObject();
+            sum += obj.at("field0").getNumber() + obj.at("field51").getNumber() +
+                   obj.at("field120").getNumber() + obj.at("field180").getNumber() +
+                   obj.at("field199").getObject().at("a").getNumber();
+        }
+        return c.docs.size();
+    });
+    jsonsimd::StructuralIndex index;
+    tester.benchmark(c.name, "5 fields", "JsonDocument", c.bytes, [&] {
+        for (const std::string& doc : c.docs) {
+            JsonDocument d = JsonDocument::parse(doc, index);
+            JsonElement root = d.root();
+            sum += root["field0"].getNumber() + root["field51"].getNumber() +
+                   root["field120"].getNumber() + root["field180"].getNumber() +
+                   root["field199"]["a"].getNumber();
+        }
+        return c.docs.size();
+    });
+    tester.benchmark(c.name, "5 fields", "OnDemand", c.bytes, [&] {
+        for (const std::string& doc : c.docs) {
+            OnDemandDocument d = OnDemandDocument::parse(doc);
+            sum += d["field0"].get<double>() + d["field51"].get<double>() +
+                   d["field120"].get<double>() + d["field180"].get<double>() +
+                   d["field199"]["a"].get<double>();
+        }
+        return c.docs.size();
+    });
+    if (sum == 0) {
+        std::cout << "unexpected sum\n";
+    }
+}
+
+// the object container on its own, with the keys of every object in the
+// corpus: build each object, look every key up and walk the members.
+// values are numbers so copying them does not hide the container
+template <typename Map>
+void memberBenchmarks(Tester& tester, const Corpus& c, const std::string& name,
+                      const std::vector<std::vector<std::string>>& keys) {
+    std::vector<Map> objects(keys.size());
+    tester.benchmark(c.name, "obj insert", name, c.bytes, [&] {
+        for (size_t i = 0; i < keys.size(); i++) {
+            Map obj;
+            for (size_t k = 0; k < keys[i].size(); k++) {
+                obj[keys[i][k]] = {double(k)};
+            }
+            objects[i] = std::move(obj);
+        }
+        return keys.size();
+    });
+    double sum = 0;
+    tester.benchmark(c.name, "obj lookup", name, c.bytes, [&] {
+        for (size_t i = 0; i < keys.size(); i++) {
+            for (const std::string& key : keys[i]) {
+                sum += objects[i].at(key).getNumber();
+            }
+        }
+        return keys.size();
+    });
+    tester.benchmark(c.name, "obj iterate", name, c.bytes, [&] {
+        for (const Map& obj : objects) {
+            for (const auto& member : obj) {
+                sum += member.second.getNumber();
+            }
+        }
+        return objects.size();
+    });
+    if (sum == 0) {
+        std::cout << "unexpected sum\n";
+    }
+}
+
+// JsonMembers (flat vector, tags, table past 16 members) against the
+// std::map it replaced, on the top level objects of the corpus
+void objectBenchmarks(Tester& tester, const Corpus& c) {
+    Json json;
+    std::vector<std::vector<std::string>> keys;
+    for (const std::string& doc : c.docs) {
+        JsonValue v = json.parse(doc);
+        keys.emplace_back();
+        for (const auto& member : v.getObject()) {
+            keys.back().push_back(member.first);
+        }
+    }
+    memberBenchmarks<JsonObject>(tester, c, "JsonMembers", keys);
+    memberBenchmarks<std::map<std::string, JsonValue>>(tester, c, "std::map", keys);
+}
+
+// one precompiled query run over every document, on a parsed tree and on
+// the streaming parse, which only builds the matching values
+void pathQueries(Tester& tester, const Corpus& c, const std::string& query) {
+    JsonPath path = query[0] == '/' ? JsonPath::pointer(query) : JsonPath::compile(query);
+    size_t missing = 0;
+    Json json;
+    for (size_t i = 0; i < c.docs.size(); i++) {
+        std::vector<std::string> tree;
+        std::vector<std::string> stream;
+        JsonValue root = json.parse(c.docs[i]);
+        for (const JsonValue* v : path.select(root)) {
+            tree.push_back(json.stringify(*v, false));
+        }
+        path.stream(c.docs[i], [&](const JsonValue& v) { stream.push_back(json.stringify(v, false)); });
+        // with .. the stream delivers nested matches first
+        std::sort(tree.begin(), tree.end());
+        std::sort(stream.begin(), stream.end());
+        if (tree != stream) {
+            mismatch(c.name, "JsonPath stream " + query, i);
+        }
+    }
+    tester.benchmark(c.name, "path", "JsonPath tree", c.bytes, [&] {
+        for (const std::string& doc : c.docs) {
+            JsonValue v = json.parse(doc);
+            missing += path.first(v) == nullptr;
+        }
+        return c.docs.size();
+    });
+    tester.benchmark(c.name, "path", "JsonPath stream", c.bytes, [&] {
+        for (const std::string& doc : c.docs) {
+            size_t found = 0;
+            path.stream(doc, [&](const JsonValue&) { found++; });
+            missing += found == 0;
+        }
+        return c.docs.size();
+    });
+    if (missing != 0) {
+        std::cout << query << " missing in " << missing << " documents\n";
+    }
+}
+
+// "64K", "16M", "1G" or plain bytes
+size_t parseSize(const std::string& s) {
+    size_t n = std::strtoull(s.c_str(), nullptr, 10);
+    switch (s.empty() ? ' ' : s.back()) {
+        case 'K': case 'k': return n << 10;
+        case 'M': case 'm': return n << 20;
+        case 'G': case 'g': return n << 30;
+        default: return n;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string size = argc > 1 ? argv[1] : "4M";
+    std::string prefix = argc > 2 ? argv[2] : "bench_results";
+    int maxThreads = argc > 3 ? atoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+    size_t bytes = parseSize(size);
+    Tester tester;
+    std::cout << "Corpora of " << size << " each\n";
+    tester.header();
+    corpusBenchmarks(tester, generateNumbers(bytes));
+    corpusBenchmarks(tester, generateStrings(bytes));
+    corpusBenchmarks(tester, generateNested(bytes));
+    Corpus wide = generateWide(bytes);
+    corpusBenchmarks(tester, wide);
+    wideFieldAccess(tester, wide);
+    objectBenchmarks(tester, wide);
+    pathQueries(tester, wide, "/field199/a");
+    Corpus ndjson = generateNdjson(bytes);
+    corpusBenchmarks(tester, ndjson);
+    pathQueries(tester, ndjson, "$.latency_ms");
+    objectBenchmarks(tester, ndjson);
+    ndjsonScaling(tester, ndjson, maxThreads);
+    tester.write(prefix, size);
+    std::cout << "Results written to " << prefix << ".json and " << prefix << ".csv\n";
+    return 0;
+}
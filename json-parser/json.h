@@ -15,24 +15,46 @@
 #include <cmath>
 #include <limits>
 #include <assert.h>
+#include "json_number.h"
+#include "json_object.h"
+#include "json_string.h"
+#include "json_writer.h"
+#include <fcntl.h>
+#include <unistd.h>
 
 struct JsonValue;
 using JsonArray = std::vector<JsonValue>;
-using JsonObject = std::map<std::string, JsonValue>;
+using JsonObject = JsonMembers<JsonValue>;
 using JsonType = std::variant<
     std::nullptr_t,
     bool,
     double,
+    int64_t,
+    uint64_t,
     std::string,
     JsonArray,
     JsonObject
 >;
 
+// integers that fit in int64 (or uint64 above INT64_MAX) are kept exact,
+// everything else is a double
 struct JsonValue {
     JsonType value;
+
+    static JsonValue fromNumber(const jsonnum::Number& n) {
+        switch (n.type) {
+            case jsonnum::NumberType::Int64: return {n.i};
+            case jsonnum::NumberType::Uint64: return {n.u};
+            default: return {n.d};
+        }
+    }
+
     bool isNull() const { return std::holds_alternative<std::nullptr_t>(value); }
     bool isBool() const { return std::holds_alternative<bool>(value); }
-    bool isNumber() const { return std::holds_alternative<double>(value); }
+    bool isNumber() const { return std::holds_alternative<double>(value) || isInteger(); }
+    bool isInteger() const {
+        return std::holds_alternative<int64_t>(value) || std::holds_alternative<uint64_t>(value);
+    }
     bool isString() const { return std::holds_alternative<std::string>(value); }
     bool isArray() const { return std::holds_alternative<JsonArray>(value); }
     bool isObject() const { return std::holds_alternative<JsonObject>(value); }
@@ -40,9 +62,25 @@ struct JsonValue {
         if (!isBool()) throw std::runtime_error("Type is not bool");
         return std::get<bool>(value);
     }
+    // integers beyond 2^53 are rounded, getNumberExact keeps them
     double getNumber() const {
-        if (!isNumber()) throw std::runtime_error("Type is not number");
-        return std::get<double>(value);
+        return getNumberExact().toDouble();
+    }
+    jsonnum::Number getNumberExact() const {
+        jsonnum::Number n;
+        if (const int64_t* i = std::get_if<int64_t>(&value)) {
+            n.type = jsonnum::NumberType::Int64;
+            n.i = *i;
+        } else if (const uint64_t* u = std::get_if<uint64_t>(&value)) {
+            n.type = jsonnum::NumberType::Uint64;
+            n.u = *u;
+        } else if (const double* d = std::get_if<double>(&value)) {
+            n.type = jsonnum::NumberType::Double;
+            n.d = *d;
+        } else {
+            throw std::runtime_error("Type is not number");
+        }
+        return n;
     }
     const std::string& getString() const {
         if (!isString()) throw std::runtime_error("Type is not string");
@@ -65,7 +103,8 @@ private:
     size_t ptr;
 
     void skipWhitespace() {
-        while (ptr < end && std::isspace(data[ptr])) { ptr++; }
+        // JSON whitespace only, std::isspace is a locale lookup per byte
+        while (ptr < end && (data[ptr] == ' ' || data[ptr] == '\n' || data[ptr] == '\r' || data[ptr] == '\t')) { ptr++; }
     }
 
     JsonValue parseValue() {
@@ -98,43 +137,21 @@ private:
     }
 
     JsonValue parseNumber() {
-        size_t start = ptr;
-        while (ptr < data.length() && (isdigit(static_cast<unsigned char>(data[ptr])) || data[ptr] == '.' || data[ptr] == '-' || data[ptr] == 'e' || data[ptr] == 'E')) {
-            ptr++;
+        jsonnum::Number value;
+        const char* first = data.data() + ptr;
+        const char* last = jsonnum::parse(first, data.data() + end, value);
+        if (last == nullptr) {
+            throw std::runtime_error("Cannot parse number");
         }
-        return {std::stod(data.substr(start, ptr - start))};
+        ptr += last - first;
+        return JsonValue::fromNumber(value);
     }
 
     JsonValue parseString() {
-        ptr++;
-        std::string result = "";
-        while (ptr < data.length() && data[ptr] != '"') {
-            if (data[ptr] == '\\') {
-                ptr++;
-                if (ptr >= data.length()) {
-                    throw std::runtime_error("Invalid escape sequence");
-                }
-                switch (data[ptr]) {
-                    case '"': result += '"'; break;
-                    case '\\': result += '\\'; break;
-                    case '/': result += '/'; break;
-                    case 'b': result += '\b'; break;
-                    case 'f': result += '\f'; break;
-                    case 'n': result += '\n'; break;
-                    case 'r': result += '\r'; break;
-                    case 't': result += '\t'; break;
-                    default: throw std::runtime_error("Invalid escape sequence");
-                }
-            } else {
-                result += data[ptr];
-            }
-            ptr++;
-        }
-        if (ptr >= data.length()) {
-            throw std::runtime_error("Unterminated string literal");
-        }
-        ptr++; // Skip final '"'
-        return {result};
+        const char* begin = data.data();
+        std::string result;
+        ptr = jsonstr::decode(begin + ptr + 1, begin + end, result) - begin;
+        return {std::move(result)};
     }
 
     JsonValue parseArray() {
@@ -143,7 +160,7 @@ private:
         JsonArray arr;
         if (data[ptr] == ']') {
             ptr++;
-            return {arr};
+            return {std::move(arr)};
         }
         while (true) {
             arr.push_back(parseValue());
@@ -156,7 +173,7 @@ private:
             }
             ptr++;
         }
-        return {arr};
+        return {std::move(arr)};
     }
 
     JsonValue parseObject() {
@@ -165,7 +182,7 @@ private:
         JsonObject obj;
         if (data[ptr] == '}') {
             ptr++;
-            return {obj};
+            return {std::move(obj)};
         }
         while (true) {
             std::string key = std::get<std::string>(parseString().value);
@@ -173,7 +190,7 @@ private:
             if (data[ptr] != ':') { throw std::runtime_error("Expected ':'"); }
             ptr++;
             skipWhitespace();
-            obj[key] = parseValue();
+            obj[std::move(key)] = parseValue();
             skipWhitespace();
             if (data[ptr] == '}') {
                 ptr++;
@@ -184,7 +201,7 @@ private:
             ptr++;
             skipWhitespace();
         }
-        return {obj};
+        return {std::move(obj)};
     }
 
     std::string readFile(std::string path) {
@@ -199,89 +216,72 @@ private:
         return res;
     }
 
-    void stringifyValue(JsonValue jv, std::string& res, int level) {
-        if (jv.isNull()) {
-            res += "null";
-        } else if (jv.isBool()) {
-            res += (jv.getBool()) ? "true" : "false";
-        } else if (jv.isNumber()) {
-            double jvNum = jv.getNumber();
-            double integral_part;
-            double fractional_part = std::modf(jvNum, &integral_part);
-            if (std::fabs(fractional_part) > std::numeric_limits<double>::epsilon()) {
-                res += std::to_string(jvNum);
-            } else if (jvNum < std::numeric_limits<int>::min() || jvNum > std::numeric_limits<int>::max()) {
-                res += std::to_string(jvNum);
-            } else {
-                res += std::to_string(static_cast<int>(jvNum));
-            }
-        } else if (jv.isString()) {
-            res += "\"" + jv.getString() + "\"";
-        } else if (jv.isArray()) {
-            res += "[\n";
-            JsonArray jvArr = jv.getArray();
-            for (size_t i = 0; i < jvArr.size(); i++) {
-                for (int j = 0; j < level; j++) {
-                    res += "\t";
-                }
-                stringifyValue(jvArr.at(i), res, level+1);
-                if (i < jvArr.size()-1) {
-                    res += ",";
-                }
-                res += "\n";
-            }
-            for (int j = 0; j < level; j++) {
-                res += "\t";
-            }
-            res += "]";
-        } else if (jv.isObject()) {
-            res += "{\n";
-            JsonObject jvObj = jv.getObject();
-            size_t counter = 0;
-            for (const auto& pair : jvObj) {
-                for (int j = 0; j < level; j++) {
-                    res += "\t";
-                }
-                res += "\t";
-                res += "\"" + pair.first + "\"" + ": ";
-                stringifyValue(pair.second, res, level+1);
-                if (counter < jvObj.size()-1) {
-                    res += ",";
-                }
-                res += "\n";
-                counter += 1;
-            }
-            for (int j = 0; j < level; j++) {
-                res += "\t";
-            }
-            res += "}";
-        } else {
-            throw std::runtime_error("Invalid JsonValue.");
+    // one value and nothing but whitespace after it, so "1-2" is an error
+    JsonValue parseDocument() {
+        end = data.size();
+        ptr = 0;
+        JsonValue value = parseValue();
+        skipWhitespace();
+        if (ptr != end) {
+            throw std::runtime_error("Unexpected trailing characters");
         }
+        return value;
     }
 
 public:
     JsonValue parse(std::string text) {
-        data = text;
-        end = data.size();
-        ptr = 0;
-        return parseValue();
+        data = std::move(text);
+        return parseDocument();
     }
 
     JsonValue parseFromFile(std::string path) {
         data = readFile(path);
-        end = data.size();
-        ptr = 0;
-        return parseValue();
+        return parseDocument();
     }
 
-    std::string stringify(JsonValue jv) {
-        std::string res = "";
-        assert(jv.isArray() || jv.isObject());
-        stringifyValue(jv, res, 0);
+    // pretty prints with one tab per level unless pretty is false
+    std::string stringify(const JsonValue& jv, bool pretty = true) {
+        std::string res;
+        StringSink sink(res);
+        JsonWriter<StringSink> writer(sink, pretty);
+        write(jv, writer);
         return res;
     }
 
+    // walks the tree by reference, nothing is copied on the way
+    template <typename Sink>
+    static void write(const JsonValue& jv, JsonWriter<Sink>& out) {
+        if (jv.isNull()) {
+            out.null();
+        } else if (jv.isBool()) {
+            out.boolean(jv.getBool());
+        } else if (jv.isNumber()) {
+            jsonnum::Number n = jv.getNumberExact();
+            switch (n.type) {
+                case jsonnum::NumberType::Int64: out.number(n.i); break;
+                case jsonnum::NumberType::Uint64: out.number(n.u); break;
+                default: out.number(n.d); break;
+            }
+        } else if (jv.isString()) {
+            out.string(jv.getString());
+        } else if (jv.isArray()) {
+            out.startArray();
+            for (const JsonValue& item : jv.getArray()) {
+                write(item, out);
+            }
+            out.endArray();
+        } else if (jv.isObject()) {
+            out.startObject();
+            for (const auto& pair : jv.getObject()) {
+                out.key(pair.first);
+                write(pair.second, out);
+            }
+            out.endObject();
+        } else {
+            throw std::runtime_error("Invalid JsonValue.");
+        }
+    }
+
     void writeToFile(std::string path, std::string json) {
         std::ofstream file(path.c_str());
         if (!file.is_open()) {
@@ -290,4 +290,24 @@ public:
         file << json;
         file.close();
     }
+
+    // streams jv to the file without building the text in memory first
+    void writeToFile(std::string path, const JsonValue& jv, bool pretty = true) {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Unable to open file");
+        }
+        try {
+            FdSink sink(fd);
+            JsonWriter<FdSink> writer(sink, pretty);
+            write(jv, writer);
+            sink.flush();
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        if (::close(fd) != 0) {
+            throw std::runtime_error("Unable to write file");
+        }
+    }
 };
@@ -0,0 +1,491 @@
+#pragma once
+
+#include "json_mmap.h"
+#include "json_number.h"
+#include "json_simd.h"
+#include "json_string.h"
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// parses JSON text straight into C++ structs, no JsonValue tree in between
+//
+// a struct becomes bindable by listing its fields once, at global scope:
+//
+//     struct Point { double x = 0; double y = 0; std::optional<std::string> label; };
+//     JSON_BIND(Point, x, y, label)
+//
+//     Point p = jsonbind::parse<Point>(text);
+//
+// fields may be bool, integers, floating point, std::string, std::vector,
+// std::optional, std::map with string keys or other bound structs. missing
+// keys leave the field untouched, unknown keys are skipped (their values
+// are still checked like any other), a type mismatch throws. member names are found
+// with a perfect hash built at compile time: one hash, one table load and
+// one compare per key. for JSON names that differ from the member name,
+// specialize JsonFields by hand with jsonbind::field("json-name", &T::member).
+
+template <typename T>
+struct JsonFields;
+
+namespace jsonbind {
+
+template <typename T, typename M>
+struct Field {
+    std::string_view name;
+    M T::*member;
+};
+
+template <typename T, typename M>
+constexpr Field<T, M> field(std::string_view name, M T::*member) {
+    return {name, member};
+}
+
+// seeded FNV-1a, the same at compile time and at run time
+constexpr uint64_t hashKey(std::string_view s, uint64_t seed) {
+    uint64_t h = 0xcbf29ce484222325ull ^ (seed * 0x9e3779b97f4a7c15ull);
+    for (char c : s) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001b3ull;
+    }
+    return h ^ (h >> 32);
+}
+
+// about n^2 / 2 slots keeps the seed search short, capped at 4096
+constexpr size_t tableBits(size_t n) {
+    size_t bits = 1;
+    while ((size_t(1) << bits) < 2 * n || ((size_t(1) << bits) < n * n / 2 && bits < 12)) {
+        bits++;
+    }
+    return bits;
+}
+
+template <size_t N>
+struct PerfectHash {
+    static constexpr size_t MASK = (size_t(1) << tableBits(N)) - 1;
+    uint64_t seed = 0;
+    std::array<uint8_t, MASK + 1> slots{}; // field index, N for empty
+
+    constexpr size_t slot(std::string_view key) const { return hashKey(key, seed) & MASK; }
+};
+
+// the throws are compile errors when evaluated as a constant
+template <size_t N>
+constexpr PerfectHash<N> makePerfectHash(const std::array<std::string_view, N>& names) {
+    static_assert(N < 255, "Too many fields");
+    for (size_t i = 0; i < N; i++) {
+        for (size_t j = i + 1; j < N; j++) {
+            if (names[i] == names[j]) {
+                throw std::logic_error("Duplicate field name");
+            }
+        }
+    }
+    PerfectHash<N> hash;
+    for (uint64_t seed = 0; seed < 100000; seed++) {
+        hash.seed = seed;
+        for (uint8_t& s : hash.slots) {
+            s = N;
+        }
+        bool collision = false;
+        for (size_t i = 0; i < N && !collision; i++) {
+            uint8_t& s = hash.slots[hash.slot(names[i])];
+            collision = s != N;
+            s = uint8_t(i);
+        }
+        if (!collision) {
+            return hash;
+        }
+    }
+    throw std::logic_error("No perfect hash found");
+}
+
+// cursor over the input, bounds checked, strings are decoded in place of
+// a separate tokenizer
+class Reader {
+private:
+    const char* p;
+    const char* end;
+    std::string keyBuffer; // keys with escapes
+    std::string closers;   // brackets skipValue has to see, innermost last
+
+    // p is after the opening quote, returns a view of the raw bytes up to
+    // the first quote or backslash, their UTF-8 is validated
+    std::string_view run() {
+        const char* start = p;
+        p = jsonstr::scan(p, end);
+        return {start, size_t(p - start)};
+    }
+
+    // p is on the closing quote or a backslash
+    void finishString(std::string& out) {
+        while (*p == '\\') {
+            p = jsonstr::unescape(p, end, out);
+            std::string_view s = run();
+            out.append(s.data(), s.size());
+        }
+        p++;
+    }
+
+    // p is on the opening quote, escapes and UTF-8 are checked
+    void skipString() {
+        p++;
+        run();
+        while (*p == '\\') {
+            keyBuffer.clear();
+            p = jsonstr::unescape(p, end, keyBuffer);
+            run();
+        }
+        p++;
+    }
+
+    void skipKey() {
+        if (peek() != '"') {
+            throw std::runtime_error("Expected string key");
+        }
+        skipString();
+        expect(':', "Expected ':'");
+    }
+
+    void skipScalar(char c) {
+        if (c == '"') {
+            skipString();
+        } else if (c == 't' || c == 'f') {
+            readBool();
+        } else if (c == 'n') {
+            consumeNull();
+        } else if (c == '-' || jsonnum::isDigit(c)) {
+            readNumber();
+        } else {
+            throw std::runtime_error("Unexpected character");
+        }
+    }
+
+public:
+    explicit Reader(std::string_view text) : p(text.data()), end(text.data() + text.size()) {}
+
+    // next non whitespace character, throws at the end of input
+    char peek() {
+        while (p < end && jsonsimd::isWhitespace(*p)) {
+            p++;
+        }
+        if (p == end) {
+            throw std::runtime_error("Unexpected end of input");
+        }
+        return *p;
+    }
+
+    bool consume(char c) {
+        if (peek() == c) {
+            p++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c, const char* error) {
+        if (!consume(c)) {
+            throw std::runtime_error(error);
+        }
+    }
+
+    // views into the input unless the key has escapes, valid until the next key
+    std::string_view readKey() {
+        expect('"', "Expected string key");
+        std::string_view s = run();
+        if (*p == '"') {
+            p++;
+            return s;
+        }
+        keyBuffer.assign(s.data(), s.size());
+        finishString(keyBuffer);
+        return keyBuffer;
+    }
+
+    void readString(std::string& out) {
+        expect('"', "Type is not string");
+        std::string_view s = run();
+        out.assign(s.data(), s.size());
+        finishString(out);
+    }
+
+    bool readBool() {
+        char c = peek();
+        if (c != 't' && c != 'f') {
+            throw std::runtime_error("Type is not bool");
+        }
+        jsonsimd::expectLiteral(p, end, c == 't' ? "true" : "false");
+        p += c == 't' ? 4 : 5;
+        return c == 't';
+    }
+
+    bool consumeNull() {
+        if (peek() != 'n') {
+            return false;
+        }
+        jsonsimd::expectLiteral(p, end, "null");
+        p += 4;
+        return true;
+    }
+
+    jsonnum::Number readNumber() {
+        char c = peek();
+        if (c != '-' && !jsonnum::isDigit(c)) {
+            throw std::runtime_error("Type is not number");
+        }
+        jsonnum::Number n;
+        p = jsonsimd::parseNumber(p, end, n);
+        return n;
+    }
+
+    template <typename I>
+    void readInteger(I& out) {
+        if (!jsonnum::toInteger(readNumber(), out)) {
+            throw std::runtime_error("Number out of range");
+        }
+    }
+
+    // skips one value of any type, as strictly as it would be read
+    void skipValue() {
+        closers.clear();
+        while (true) {
+            char c = peek();
+            if (c == '{' || c == '[') {
+                p++;
+                closers.push_back(c == '{' ? '}' : ']');
+                if (!consume(closers.back())) {
+                    if (c == '{') {
+                        skipKey();
+                    }
+                    continue;
+                }
+                closers.pop_back();
+            } else {
+                skipScalar(c);
+            }
+            while (!closers.empty() && consume(closers.back())) {
+                closers.pop_back();
+            }
+            if (closers.empty()) {
+                return;
+            }
+            expect(',', "Expected ',' or closing bracket");
+            if (closers.back() == '}') {
+                skipKey();
+            }
+        }
+    }
+
+    void finish() {
+        while (p < end && jsonsimd::isWhitespace(*p)) {
+            p++;
+        }
+        if (p != end) {
+            throw std::runtime_error("Unexpected trailing characters");
+        }
+    }
+};
+
+template <typename T, typename = void>
+struct IsBound : std::false_type {};
+template <typename T>
+struct IsBound<T, std::void_t<decltype(JsonFields<T>::fields)>> : std::true_type {};
+
+template <typename T>
+struct IsVector : std::false_type {};
+template <typename T, typename A>
+struct IsVector<std::vector<T, A>> : std::true_type {};
+
+template <typename T>
+struct IsOptional : std::false_type {};
+template <typename T>
+struct IsOptional<std::optional<T>> : std::true_type {};
+
+template <typename T>
+struct IsStringMap : std::false_type {};
+template <typename T, typename C, typename A>
+struct IsStringMap<std::map<std::string, T, C, A>> : std::true_type {};
+
+template <typename V>
+void read(Reader& r, V& out);
+
+template <typename T>
+struct Binding {
+    using Fields = std::decay_t<decltype(JsonFields<T>::fields)>;
+    static constexpr size_t N = std::tuple_size_v<Fields>;
+    using Handler = void (*)(Reader&, T&);
+
+    template <size_t I>
+    static void readField(Reader& r, T& obj) {
+        read(r, obj.*(std::get<I>(JsonFields<T>::fields).member));
+    }
+
+    template <size_t... I>
+    static constexpr std::array<std::string_view, N> namesOf(std::index_sequence<I...>) {
+        return {std::get<I>(JsonFields<T>::fields).name...};
+    }
+
+    template <size_t... I>
+    static constexpr std::array<Handler, N> handlersOf(std::index_sequence<I...>) {
+        return {&readField<I>...};
+    }
+
+    static constexpr std::array<std::string_view, N> names = namesOf(std::make_index_sequence<N>());
+    static constexpr PerfectHash<N> hash = makePerfectHash<N>(names);
+    static constexpr std::array<Handler, N> handlers = handlersOf(std::make_index_sequence<N>());
+
+    // field index, N if the key is not a field
+    static size_t find(std::string_view key) {
+        size_t i = hash.slots[hash.slot(key)];
+        return i < N && names[i] == key ? i : N;
+    }
+};
+
+template <typename T>
+void readObject(Reader& r, T& obj) {
+    using B = Binding<T>;
+    r.expect('{', "Type is not object");
+    if (r.consume('}')) {
+        return;
+    }
+    do {
+        std::string_view key = r.readKey();
+        r.expect(':', "Expected ':'");
+        size_t i = B::find(key);
+        if (i == B::N) {
+            r.skipValue();
+        } else {
+            B::handlers[i](r, obj);
+        }
+    } while (r.consume(','));
+    r.expect('}', "Expected ',' or '}'");
+}
+
+template <typename V>
+void read(Reader& r, V& out) {
+    if constexpr (std::is_same_v<V, bool>) {
+        out = r.readBool();
+    } else if constexpr (std::is_integral_v<V>) {
+        r.readInteger(out);
+    } else if constexpr (std::is_floating_point_v<V>) {
+        out = V(r.readNumber().toDouble());
+    } else if constexpr (std::is_same_v<V, std::string>) {
+        r.readString(out);
+    } else if constexpr (IsOptional<V>::value) {
+        if (r.consumeNull()) {
+            out.reset();
+        } else {
+            if (!out) {
+                out.emplace();
+            }
+            read(r, *out);
+        }
+    } else if constexpr (IsVector<V>::value) {
+        // clear keeps the capacity when a target is reused
+        out.clear();
+        r.expect('[', "Type is not array");
+        if (r.consume(']')) {
+            return;
+        }
+        do {
+            typename V::value_type item{};
+            read(r, item);
+            out.push_back(std::move(item));
+        } while (r.consume(','));
+        r.expect(']', "Expected ',' or ']'");
+    } else if constexpr (IsStringMap<V>::value) {
+        out.clear();
+        r.expect('{', "Type is not object");
+        if (r.consume('}')) {
+            return;
+        }
+        do {
+            std::string key(r.readKey());
+            r.expect(':', "Expected ':'");
+            read(r, out[key]);
+        } while (r.consume(','));
+        r.expect('}', "Expected ',' or '}'");
+    } else {
+        static_assert(IsBound<V>::value, "Type has no JSON_BIND");
+        readObject(r, out);
+    }
+}
+
+// fills out from text, fields that are not in the text keep their values
+template <typename T>
+void parseInto(std::string_view text, T& out) {
+    Reader r(text);
+    read(r, out);
+    r.finish();
+}
+
+template <typename T>
+T parse(std::string_view text) {
+    T out{};
+    parseInto(text, out);
+    return out;
+}
+
+template <typename T>
+T parseFromFile(const std::string& path) {
+    MappedFile file(path);
+    return parse<T>(file.view());
+}
+
+} // namespace jsonbind
+
+// field lists of up to 32 members
+#define JSONBIND_EXPAND(x) x
+#define JSONBIND_CAT(a, b) JSONBIND_CAT_(a, b)
+#define JSONBIND_CAT_(a, b) a##b
+#define JSONBIND_NARGS(...) JSONBIND_EXPAND(JSONBIND_NARGS_(__VA_ARGS__, 32,31,30,29,28,27,26,25,24,23,22,21,20,19,18,17,16,15,14,13,12,11,10,9,8,7,6,5,4,3,2,1))
+#define JSONBIND_NARGS_(_1,_2,_3,_4,_5,_6,_7,_8,_9,_10,_11,_12,_13,_14,_15,_16,_17,_18,_19,_20,_21,_22,_23,_24,_25,_26,_27,_28,_29,_30,_31,_32, N, ...) N
+#define JSONBIND_MAP(m, T, ...) JSONBIND_EXPAND(JSONBIND_CAT(JSONBIND_MAP_, JSONBIND_NARGS(__VA_ARGS__))(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_1(m, T, a) m(T, a)
+#define JSONBIND_MAP_2(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_1(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_3(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_2(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_4(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_3(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_5(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_4(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_6(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_5(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_7(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_6(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_8(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_7(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_9(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_8(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_10(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_9(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_11(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_10(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_12(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_11(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_13(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_12(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_14(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_13(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_15(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_14(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_16(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_15(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_17(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_16(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_18(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_17(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_19(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_18(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_20(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_19(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_21(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_20(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_22(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_21(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_23(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_22(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_24(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_23(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_25(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_24(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_26(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_25(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_27(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_26(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_28(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_27(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_29(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_28(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_30(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_29(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_31(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_30(m, T, __VA_ARGS__))
+#define JSONBIND_MAP_32(m, T, a, ...) m(T, a), JSONBIND_EXPAND(JSONBIND_MAP_31(m, T, __VA_ARGS__))
+#define JSONBIND_FIELD(T, name) jsonbind::field(#name, &T::name)
+
+#define JSON_BIND(T, ...) \
+    template <> \
+    struct JsonFields<T> { \
+        static constexpr auto fields = std::make_tuple(JSONBIND_MAP(JSONBIND_FIELD, T, __VA_ARGS__)); \
+    };
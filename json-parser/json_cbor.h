@@ -0,0 +1,689 @@
+#pragma once
+
+#include "json.h"
+#include "json_mmap.h"
+#include "json_writer.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// binary encoding of JsonValue in CBOR (RFC 8949)
+//
+// every item starts with a head byte, the major type in the top 3 bits and
+// a small value or argument size in the low 5, followed by 0-8 big endian
+// argument bytes. strings carry their byte length and are copied with one
+// memcpy, numbers are integers or IEEE floats, so decoding does no text
+// scanning and no float parsing. the encoder writes definite lengths and
+// the shortest heads, int64/uint64 values and whole doubles below 2^53 as
+// integers and everything else as float32 when that is exact, float64
+// otherwise. integers decode to int64/uint64 when they fit. the decoder also
+// takes indefinite length arrays and maps, half floats and tags, which
+// other encoders produce.
+//
+// CborDocument reads lazily, values are pointers into the bytes and only
+// heads are walked to skip what is not asked for.
+//
+// parseFromFileCached keeps <path>.cbor next to a JSON file and decodes it
+// instead of parsing the text while the source keeps its size, mtime and
+// inode.
+
+namespace jsoncbor {
+
+enum Major : uint8_t { Unsigned, Negative, Bytes, Text, Array, Map, Tag, Simple };
+
+constexpr uint8_t FALSE_BYTE = 0xf4;
+constexpr uint8_t TRUE_BYTE = 0xf5;
+constexpr uint8_t NULL_BYTE = 0xf6;
+constexpr uint8_t BREAK_BYTE = 0xff;
+constexpr uint8_t INDEFINITE = 31;
+// tag 55799 marks a file as CBOR, cache files start with it
+constexpr uint64_t SELF_DESCRIBE = 55799;
+constexpr uint64_t CACHE_VERSION = 1;
+
+struct Head {
+    uint8_t major;
+    uint8_t info; // low 5 bits of the head byte
+    uint64_t arg; // value, length or count, 0 when indefinite
+};
+
+inline uint64_t loadBig(const uint8_t* p, size_t n) {
+    switch (n) {
+        case 1: return p[0];
+        case 2: { uint16_t v; std::memcpy(&v, p, 2); return __builtin_bswap16(v); }
+        case 4: { uint32_t v; std::memcpy(&v, p, 4); return __builtin_bswap32(v); }
+        default: { uint64_t v; std::memcpy(&v, p, 8); return __builtin_bswap64(v); }
+    }
+}
+
+inline const uint8_t* readHead(const uint8_t* p, const uint8_t* end, Head& h) {
+    if (p == end) {
+        throw std::runtime_error("Unexpected end of CBOR");
+    }
+    h.major = *p >> 5;
+    h.info = *p & 31;
+    p++;
+    if (h.info < 24) {
+        h.arg = h.info;
+        return p;
+    }
+    if (h.info == INDEFINITE) {
+        if (h.major < Bytes || h.major == Tag) {
+            throw std::runtime_error("Invalid CBOR");
+        }
+        h.arg = 0;
+        return p;
+    }
+    if (h.info > 27) {
+        throw std::runtime_error("Invalid CBOR");
+    }
+    size_t n = size_t(1) << (h.info - 24);
+    if (size_t(end - p) < n) {
+        throw std::runtime_error("Unexpected end of CBOR");
+    }
+    h.arg = loadBig(p, n);
+    return p + n;
+}
+
+// head of the next value, tags are skipped
+inline const uint8_t* readValueHead(const uint8_t* p, const uint8_t* end, Head& h) {
+    p = readHead(p, end, h);
+    while (h.major == Tag) {
+        p = readHead(p, end, h);
+    }
+    return p;
+}
+
+inline bool isFloat(const Head& h) { return h.major == Simple && h.info >= 25 && h.info <= 27; }
+
+inline double toDouble(const Head& h) {
+    switch (h.info) {
+        case 25: {
+            int exp = (h.arg >> 10) & 0x1f;
+            double mant = double(h.arg & 0x3ff);
+            double v = exp == 0 ? std::ldexp(mant, -24)
+                     : exp != 31 ? std::ldexp(mant + 1024, exp - 25)
+                     : mant == 0 ? std::numeric_limits<double>::infinity()
+                                 : std::numeric_limits<double>::quiet_NaN();
+            return h.arg & 0x8000 ? -v : v;
+        }
+        case 26: {
+            uint32_t bits = uint32_t(h.arg);
+            float f;
+            std::memcpy(&f, &bits, sizeof(f));
+            return f;
+        }
+        default: {
+            double d;
+            std::memcpy(&d, &h.arg, sizeof(d));
+            return d;
+        }
+    }
+}
+
+// number of any encoding, integers beyond 2^53 are rounded
+inline double number(const Head& h) {
+    if (h.major == Unsigned) {
+        return double(h.arg);
+    }
+    if (h.major == Negative) {
+        return -1.0 - double(h.arg);
+    }
+    return toDouble(h);
+}
+
+inline std::string_view text(const uint8_t* p, const uint8_t* end, const Head& h) {
+    if (h.info == INDEFINITE) {
+        throw std::runtime_error("Unsupported CBOR");
+    }
+    if (h.arg > uint64_t(end - p)) {
+        throw std::runtime_error("Unexpected end of CBOR");
+    }
+    return {reinterpret_cast<const char*>(p), size_t(h.arg)};
+}
+
+// pointer just past the value at p
+inline const uint8_t* skip(const uint8_t* p, const uint8_t* end) {
+    Head h;
+    p = readValueHead(p, end, h);
+    switch (h.major) {
+        case Unsigned:
+        case Negative: return p;
+        case Bytes:
+        case Text: return p + text(p, end, h).size();
+        case Array:
+        case Map: {
+            if (h.info == INDEFINITE) {
+                while (true) {
+                    if (p == end) {
+                        throw std::runtime_error("Unexpected end of CBOR");
+                    }
+                    if (*p == BREAK_BYTE) {
+                        return p + 1;
+                    }
+                    p = skip(p, end);
+                }
+            }
+            // every item takes at least one byte
+            if (h.arg > uint64_t(end - p)) {
+                throw std::runtime_error("Unexpected end of CBOR");
+            }
+            for (uint64_t n = h.major == Map ? h.arg * 2 : h.arg; n > 0; n--) {
+                p = skip(p, end);
+            }
+            return p;
+        }
+        default: {
+            if (h.info == INDEFINITE || h.info < 20 || h.info == 24) {
+                throw std::runtime_error("Unsupported CBOR");
+            }
+            return p;
+        }
+    }
+}
+
+template <typename Sink>
+void writeHead(Sink& out, uint8_t major, uint64_t n) {
+    uint8_t m = uint8_t(major << 5);
+    if (n < 24) {
+        out.put(char(m | n));
+        return;
+    }
+    char buf[9];
+    size_t bytes = n <= 0xff ? 1 : n <= 0xffff ? 2 : n <= 0xffffffff ? 4 : 8;
+    buf[0] = char(m | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27));
+    for (size_t i = 0; i < bytes; i++) {
+        buf[1 + i] = char(n >> (8 * (bytes - 1 - i)));
+    }
+    out.write(buf, 1 + bytes);
+}
+
+template <typename Sink>
+void writeNumber(Sink& out, double d) {
+    if (d == std::trunc(d) && std::fabs(d) < 9007199254740992.0 && !(d == 0 && std::signbit(d))) {
+        if (d >= 0) {
+            writeHead(out, Unsigned, uint64_t(d));
+        } else {
+            writeHead(out, Negative, uint64_t(-1 - d));
+        }
+        return;
+    }
+    char buf[9];
+    if (std::fabs(d) <= std::numeric_limits<float>::max() && double(float(d)) == d) {
+        float f = float(d);
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        bits = __builtin_bswap32(bits);
+        buf[0] = char(0xfa);
+        std::memcpy(buf + 1, &bits, sizeof(bits));
+        out.write(buf, 5);
+        return;
+    }
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    bits = __builtin_bswap64(bits);
+    buf[0] = char(0xfb);
+    std::memcpy(buf + 1, &bits, sizeof(bits));
+    out.write(buf, 9);
+}
+
+template <typename Sink>
+void writeNumber(Sink& out, const jsonnum::Number& n) {
+    switch (n.type) {
+        case jsonnum::NumberType::Int64:
+            if (n.i >= 0) {
+                writeHead(out, Unsigned, uint64_t(n.i));
+            } else {
+                writeHead(out, Negative, uint64_t(-1 - n.i));
+            }
+            break;
+        case jsonnum::NumberType::Uint64: writeHead(out, Unsigned, n.u); break;
+        default: writeNumber(out, n.d); break;
+    }
+}
+
+template <typename Sink>
+void encode(const JsonValue& v, Sink& out) {
+    if (v.isNull()) {
+        out.put(char(NULL_BYTE));
+    } else if (v.isBool()) {
+        out.put(char(v.getBool() ? TRUE_BYTE : FALSE_BYTE));
+    } else if (v.isNumber()) {
+        writeNumber(out, v.getNumberExact());
+    } else if (v.isString()) {
+        const std::string& s = v.getString();
+        writeHead(out, Text, s.size());
+        out.write(s.data(), s.size());
+    } else if (v.isArray()) {
+        writeHead(out, Array, v.getArray().size());
+        for (const JsonValue& e : v.getArray()) {
+            encode(e, out);
+        }
+    } else {
+        writeHead(out, Map, v.getObject().size());
+        for (const auto& member : v.getObject()) {
+            writeHead(out, Text, member.first.size());
+            out.write(member.first.data(), member.first.size());
+            encode(member.second, out);
+        }
+    }
+}
+
+inline std::string encode(const JsonValue& v) {
+    std::string out;
+    StringSink sink(out);
+    encode(v, sink);
+    return out;
+}
+
+class Decoder {
+private:
+    const uint8_t* p;
+    const uint8_t* end;
+
+    // reserves no more than the remaining bytes could hold
+    uint64_t capacity(const Head& h) const {
+        return h.info == INDEFINITE ? 0 : std::min<uint64_t>(h.arg, end - p);
+    }
+
+    bool more(const Head& h, uint64_t& left) {
+        if (h.info != INDEFINITE) {
+            return left-- > 0;
+        }
+        if (p == end) {
+            throw std::runtime_error("Unexpected end of CBOR");
+        }
+        if (*p == BREAK_BYTE) {
+            p++;
+            return false;
+        }
+        return true;
+    }
+
+public:
+    Decoder(const uint8_t* p, const uint8_t* end) : p(p), end(end) {}
+
+    const uint8_t* position() const { return p; }
+
+    JsonValue value() {
+        Head h;
+        p = readValueHead(p, end, h);
+        switch (h.major) {
+            case Unsigned:
+                if (h.arg > uint64_t(std::numeric_limits<int64_t>::max())) return {h.arg};
+                return {int64_t(h.arg)};
+            case Negative:
+                if (h.arg > uint64_t(std::numeric_limits<int64_t>::max())) return {number(h)};
+                return {-1 - int64_t(h.arg)};
+            case Text: {
+                std::string_view s = text(p, end, h);
+                p += s.size();
+                return {std::string(s)};
+            }
+            case Array: {
+                JsonArray arr;
+                arr.reserve(capacity(h));
+                for (uint64_t left = h.arg; more(h, left);) {
+                    arr.push_back(value());
+                }
+                return {std::move(arr)};
+            }
+            case Map: {
+                JsonObject obj;
+                obj.reserve(capacity(h));
+                for (uint64_t left = h.arg; more(h, left);) {
+                    Head k;
+                    p = readValueHead(p, end, k);
+                    if (k.major != Text) {
+                        throw std::runtime_error("Expected string key");
+                    }
+                    std::string_view key = text(p, end, k);
+                    p += key.size();
+                    JsonValue v = value();
+                    obj[key] = std::move(v);
+                }
+                return {std::move(obj)};
+            }
+            case Simple: {
+                if (isFloat(h)) {
+                    return {toDouble(h)};
+                }
+                switch (h.info) {
+                    case FALSE_BYTE & 31: return {false};
+                    case TRUE_BYTE & 31: return {true};
+                    case NULL_BYTE & 31:
+                    case 23: return {nullptr}; // undefined
+                    default: throw std::runtime_error("Unsupported CBOR");
+                }
+            }
+            default: throw std::runtime_error("Unsupported CBOR");
+        }
+    }
+};
+
+inline JsonValue decode(std::string_view bytes) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(bytes.data());
+    Decoder decoder(p, p + bytes.size());
+    JsonValue v = decoder.value();
+    if (decoder.position() != p + bytes.size()) {
+        throw std::runtime_error("Unexpected trailing bytes");
+    }
+    return v;
+}
+
+// what a cache file is checked against, read before the source is parsed
+// so a change during the parse makes the cache stale
+struct SourceStamp {
+    uint64_t size;
+    uint64_t mtimeNs;
+    uint64_t inode;
+};
+
+inline SourceStamp stampOf(const std::string& path) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        throw std::runtime_error("Unable to open file");
+    }
+    return {uint64_t(st.st_size), uint64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec,
+            uint64_t(st.st_ino)};
+}
+
+inline std::string cachePath(const std::string& path) { return path + ".cbor"; }
+
+// tag 55799 [version, size, mtime ns, inode, value]
+template <typename Sink>
+void encodeCache(const JsonValue& v, const SourceStamp& stamp, Sink& out) {
+    writeHead(out, Tag, SELF_DESCRIBE);
+    writeHead(out, Array, 5);
+    writeHead(out, Unsigned, CACHE_VERSION);
+    writeHead(out, Unsigned, stamp.size);
+    writeHead(out, Unsigned, stamp.mtimeNs);
+    writeHead(out, Unsigned, stamp.inode);
+    encode(v, out);
+}
+
+// offset of the value in a cache file made from stamp, 0 if it is not one
+inline size_t cachedValueOffset(std::string_view bytes, const SourceStamp& stamp) {
+    const uint8_t* begin = reinterpret_cast<const uint8_t*>(bytes.data());
+    const uint8_t* end = begin + bytes.size();
+    const uint64_t expected[] = {CACHE_VERSION, stamp.size, stamp.mtimeNs, stamp.inode};
+    try {
+        Head h;
+        const uint8_t* p = readHead(begin, end, h);
+        if (h.major != Tag || h.arg != SELF_DESCRIBE) {
+            return 0;
+        }
+        p = readHead(p, end, h);
+        if (h.major != Array || h.arg != 5) {
+            return 0;
+        }
+        for (uint64_t field : expected) {
+            p = readHead(p, end, h);
+            if (h.major != Unsigned || h.arg != field) {
+                return 0;
+            }
+        }
+        return p - begin;
+    } catch (const std::runtime_error&) {
+        return 0;
+    }
+}
+
+// written next to the source and renamed into place, a directory that is
+// not writable only costs the next start another parse
+inline void writeCache(const std::string& path, const SourceStamp& stamp, const JsonValue& v) {
+    std::string cache = cachePath(path);
+    std::string tmp = cache + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    bool ok = true;
+    try {
+        FdSink sink(fd);
+        encodeCache(v, stamp, sink);
+        sink.flush();
+    } catch (const std::runtime_error&) {
+        ok = false;
+    }
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), cache.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+    }
+}
+
+// Json::parseFromFile, through the cache when it is current
+inline JsonValue parseFromFileCached(const std::string& path) {
+    SourceStamp stamp = stampOf(path);
+    try {
+        MappedFile cache(cachePath(path));
+        size_t offset = cachedValueOffset(cache.view(), stamp);
+        if (offset != 0) {
+            return decode(cache.view().substr(offset));
+        }
+    } catch (const std::runtime_error&) {
+        // missing or damaged, parsed and written again below
+    }
+    JsonValue v = Json().parseFromFile(path);
+    writeCache(path, stamp, v);
+    return v;
+}
+
+} // namespace jsoncbor
+
+class CborDocument;
+
+// one value inside a CborDocument, reads only its own head until asked
+class CborElement {
+private:
+    const uint8_t* p; // first byte of the value, tags included
+    const uint8_t* end;
+
+    jsoncbor::Head head(const uint8_t*& q) const {
+        jsoncbor::Head h;
+        q = jsoncbor::readValueHead(p, end, h);
+        return h;
+    }
+
+    jsoncbor::Head head() const {
+        const uint8_t* q;
+        return head(q);
+    }
+
+    // calls f(q) at each array element or map key, f returns the pointer
+    // past what it read or nullptr to stop
+    template <typename F>
+    void walk(uint8_t major, const char* error, F&& f) const {
+        const uint8_t* q;
+        jsoncbor::Head h = head(q);
+        if (h.major != major) throw std::runtime_error(error);
+        for (uint64_t left = h.arg;;) {
+            if (h.info == jsoncbor::INDEFINITE) {
+                if (q == end) throw std::runtime_error("Unexpected end of CBOR");
+                if (*q == jsoncbor::BREAK_BYTE) return;
+            } else if (left-- == 0) {
+                return;
+            }
+            q = f(q);
+            if (q == nullptr) return;
+        }
+    }
+
+public:
+    CborElement(const uint8_t* p, const uint8_t* end) : p(p), end(end) {}
+
+    bool isNull() const {
+        jsoncbor::Head h = head();
+        return h.major == jsoncbor::Simple && (h.info == 22 || h.info == 23);
+    }
+    bool isBool() const {
+        jsoncbor::Head h = head();
+        return h.major == jsoncbor::Simple && (h.info == 20 || h.info == 21);
+    }
+    bool isNumber() const {
+        jsoncbor::Head h = head();
+        return h.major == jsoncbor::Unsigned || h.major == jsoncbor::Negative || jsoncbor::isFloat(h);
+    }
+    bool isString() const { return head().major == jsoncbor::Text; }
+    bool isArray() const { return head().major == jsoncbor::Array; }
+    bool isObject() const { return head().major == jsoncbor::Map; }
+
+    bool getBool() const {
+        if (!isBool()) throw std::runtime_error("Type is not bool");
+        return head().info == 21;
+    }
+    double getNumber() const {
+        if (!isNumber()) throw std::runtime_error("Type is not number");
+        return jsoncbor::number(head());
+    }
+    // points into the document
+    std::string_view getString() const {
+        const uint8_t* q;
+        jsoncbor::Head h = head(q);
+        if (h.major != jsoncbor::Text) throw std::runtime_error("Type is not string");
+        return jsoncbor::text(q, end, h);
+    }
+
+    // elements or members
+    size_t size() const {
+        const uint8_t* q;
+        jsoncbor::Head h = head(q);
+        if (h.major != jsoncbor::Array && h.major != jsoncbor::Map) {
+            throw std::runtime_error("Type is not array or object");
+        }
+        if (h.info != jsoncbor::INDEFINITE) {
+            return h.arg;
+        }
+        size_t n = 0;
+        walk(h.major, "", [&](const uint8_t* e) {
+            n++;
+            e = jsoncbor::skip(e, end);
+            return h.major == jsoncbor::Map ? jsoncbor::skip(e, end) : e;
+        });
+        return n;
+    }
+
+    // linear scan over the keys, first match wins
+    std::optional<CborElement> find(std::string_view key) const {
+        std::optional<CborElement> found;
+        walk(jsoncbor::Map, "Type is not object", [&](const uint8_t* k) -> const uint8_t* {
+            jsoncbor::Head h;
+            const uint8_t* q = jsoncbor::readValueHead(k, end, h);
+            if (h.major != jsoncbor::Text) throw std::runtime_error("Expected string key");
+            std::string_view name = jsoncbor::text(q, end, h);
+            q += name.size();
+            if (name == key) {
+                found = CborElement(q, end);
+                return nullptr;
+            }
+            return jsoncbor::skip(q, end);
+        });
+        return found;
+    }
+
+    CborElement operator[](std::string_view key) const {
+        std::optional<CborElement> v = find(key);
+        if (!v) throw std::runtime_error("Key not found");
+        return *v;
+    }
+
+    // n-th element, skips the ones before it
+    CborElement at(size_t n) const {
+        std::optional<CborElement> found;
+        size_t i = 0;
+        walk(jsoncbor::Array, "Type is not array", [&](const uint8_t* e) -> const uint8_t* {
+            if (i++ == n) {
+                found = CborElement(e, end);
+                return nullptr;
+            }
+            return jsoncbor::skip(e, end);
+        });
+        if (!found) throw std::runtime_error("Index out of range");
+        return *found;
+    }
+    CborElement operator[](size_t n) const { return at(n); }
+
+    // calls f(CborElement) for each element
+    template <typename F>
+    void forEach(F&& f) const {
+        walk(jsoncbor::Array, "Type is not array", [&](const uint8_t* e) {
+            f(CborElement(e, end));
+            return jsoncbor::skip(e, end);
+        });
+    }
+
+    // calls f(key, CborElement) for each member
+    template <typename F>
+    void forEachMember(F&& f) const {
+        walk(jsoncbor::Map, "Type is not object", [&](const uint8_t* k) {
+            jsoncbor::Head h;
+            const uint8_t* q = jsoncbor::readValueHead(k, end, h);
+            if (h.major != jsoncbor::Text) throw std::runtime_error("Expected string key");
+            std::string_view name = jsoncbor::text(q, end, h);
+            q += name.size();
+            f(name, CborElement(q, end));
+            return jsoncbor::skip(q, end);
+        });
+    }
+
+    // copies the subtree into the JsonValue tree Json works with
+    JsonValue toValue() const { return jsoncbor::Decoder(p, end).value(); }
+};
+
+class CborDocument {
+private:
+    std::string bytes;
+    std::shared_ptr<const MappedFile> source;
+    size_t offset = 0; // of the root value
+
+    std::string_view view() const { return source ? source->view() : std::string_view(bytes); }
+
+public:
+    static CborDocument parse(std::string bytes) {
+        CborDocument doc;
+        doc.bytes = std::move(bytes);
+        return doc;
+    }
+
+    // maps the file and keeps it mapped for the lifetime of the document
+    static CborDocument parseFromFile(const std::string& path) {
+        CborDocument doc;
+        doc.source = std::make_shared<const MappedFile>(path);
+        return doc;
+    }
+
+    // the cache of a JSON file, mapped when current, otherwise the file is
+    // parsed, encoded and the cache written again
+    static CborDocument parseFromFileCached(const std::string& path) {
+        jsoncbor::SourceStamp stamp = jsoncbor::stampOf(path);
+        CborDocument doc;
+        try {
+            doc.source = std::make_shared<const MappedFile>(jsoncbor::cachePath(path));
+            doc.offset = jsoncbor::cachedValueOffset(doc.source->view(), stamp);
+            if (doc.offset != 0) {
+                return doc;
+            }
+        } catch (const std::runtime_error&) {
+            // missing, parsed below
+        }
+        JsonValue v = Json().parseFromFile(path);
+        jsoncbor::writeCache(path, stamp, v);
+        return parse(jsoncbor::encode(v));
+    }
+
+    CborElement root() const {
+        std::string_view all = view();
+        const uint8_t* begin = reinterpret_cast<const uint8_t*>(all.data());
+        return {begin + offset, begin + all.size()};
+    }
+    CborElement operator[](std::string_view key) const { return root()[key]; }
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// read-only memory mapping of a whole file
+//
+// parsers that take a string_view can run straight over the mapping
+// instead of copying the file into a std::string first. documents that hand
+// out views into the input hold on to the mapping through a shared_ptr.
+
+class MappedFile {
+private:
+    const char* ptr = nullptr;
+    size_t length = 0;
+
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Unable to open file");
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Unable to stat file");
+        }
+        length = st.st_size;
+        if (length > 0) {
+            void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Unable to map file");
+            }
+            // parsers read front to back, the advice values are not flags
+            ::madvise(p, length, MADV_SEQUENTIAL);
+            ::madvise(p, length, MADV_WILLNEED);
+            ptr = static_cast<const char*>(p);
+        }
+        ::close(fd); // the mapping stays valid
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() {
+        if (ptr != nullptr) {
+            ::munmap(const_cast<char*>(ptr), length);
+        }
+    }
+
+    const char* data() const { return ptr == nullptr ? "" : ptr; }
+    size_t size() const { return length; }
+    std::string_view view() const { return {data(), length}; }
+};
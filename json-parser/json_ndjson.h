@@ -0,0 +1,304 @@
+#pragma once
+
+#include "json_mmap.h"
+#include "json_tape.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// parallel parsing of newline delimited JSON (one value per line)
+//
+// the input is cut into chunks of about chunkBytes that end on a newline,
+// every chunk is parsed into JsonDocuments on a work stealing pool. ordered
+// delivery hands records to the callback on the calling thread in input
+// order, at most a few chunks per worker are buffered. unordered delivery
+// calls the callback straight from the workers as records are parsed.
+
+// fixed set of workers, each with its own deque. workers take their own
+// newest task first and steal the oldest task of another worker when idle.
+class WorkStealingPool {
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> nextQueue{0};
+    bool stopping = false;
+
+    bool tryRun(size_t self) {
+        std::function<void()> task;
+        {
+            Queue& own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+            }
+        }
+        for (size_t k = 1; !task && k < queues.size(); k++) {
+            Queue& victim = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+            }
+        }
+        if (!task) {
+            return false;
+        }
+        queued.fetch_sub(1);
+        task();
+        return true;
+    }
+
+    void run(size_t self) {
+        while (true) {
+            if (tryRun(self)) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+            if (stopping && queued.load() == 0) {
+                return;
+            }
+        }
+    }
+
+public:
+    explicit WorkStealingPool(size_t numThreads) {
+        numThreads = std::max<size_t>(numThreads, 1);
+        for (size_t i = 0; i < numThreads; i++) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 0; i < numThreads; i++) {
+            threads.emplace_back(&WorkStealingPool::run, this, i);
+        }
+    }
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    // runs what is still queued, then joins
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    void submit(std::function<void()> task) {
+        Queue& queue = *queues[nextQueue.fetch_add(1) % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            queued.fetch_add(1);
+        }
+        wake.notify_one();
+    }
+
+    size_t size() const { return threads.size(); }
+};
+
+class NdjsonParser {
+private:
+    struct Chunk {
+        size_t begin;
+        size_t end;
+    };
+
+    // completion state of one parse call, tasks reference it until inFlight
+    // drops to zero
+    struct Batch {
+        std::mutex mutex;
+        std::condition_variable done;
+        std::vector<std::vector<JsonDocument>> results;
+        std::vector<char> ready;
+        size_t inFlight = 0;
+        std::exception_ptr error;
+
+        void finish(size_t k, std::exception_ptr e) {
+            // notify under the lock, the batch may be gone right after it
+            std::lock_guard<std::mutex> lock(mutex);
+            ready[k] = 1;
+            inFlight--;
+            if (e && !error) {
+                error = e;
+            }
+            done.notify_all();
+        }
+        void waitIdle() {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this] { return inFlight == 0; });
+        }
+    };
+
+    WorkStealingPool pool;
+    size_t chunkBytes;
+
+    std::vector<Chunk> split(std::string_view input) const {
+        std::vector<Chunk> chunks;
+        size_t begin = 0;
+        while (begin < input.size()) {
+            size_t end = std::min(begin + chunkBytes, input.size());
+            if (end < input.size()) {
+                const void* nl = std::memchr(input.data() + end, '\n', input.size() - end);
+                end = nl == nullptr ? input.size() : static_cast<const char*>(nl) - input.data() + 1;
+            }
+            chunks.push_back({begin, end});
+            begin = end;
+        }
+        return chunks;
+    }
+
+    static bool blank(const char* p, const char* end) {
+        for (; p < end; p++) {
+            if (!jsonsimd::isWhitespace(*p)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // parses every non blank line of the chunk
+    template <typename F>
+    static void parseChunk(std::string_view input, Chunk chunk, F&& onRecord) {
+        thread_local jsonsimd::StructuralIndex index;
+        const char* p = input.data() + chunk.begin;
+        const char* end = input.data() + chunk.end;
+        while (p < end) {
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            const char* lineEnd = nl == nullptr ? end : nl;
+            if (!blank(p, lineEnd)) {
+                try {
+                    onRecord(JsonDocument::parse(std::string_view(p, lineEnd - p), index));
+                } catch (const std::runtime_error& e) {
+                    throw std::runtime_error(std::string(e.what()) + " in record at byte " +
+                                             std::to_string(p - input.data()));
+                }
+            }
+            p = lineEnd + 1;
+        }
+    }
+
+public:
+    explicit NdjsonParser(size_t numThreads = std::thread::hardware_concurrency(),
+                          size_t chunkBytes = 1 << 20)
+        : pool(numThreads), chunkBytes(std::max<size_t>(chunkBytes, 1)) {}
+
+    // onRecord(JsonDocument&) runs on the calling thread in input order,
+    // returns the number of records
+    template <typename F>
+    size_t parse(std::string_view input, F&& onRecord) {
+        std::vector<Chunk> chunks = split(input);
+        Batch batch;
+        batch.results.resize(chunks.size());
+        batch.ready.assign(chunks.size(), 0);
+        size_t window = 4 * pool.size();
+        size_t submitted = 0;
+        auto submitNext = [&]() {
+            size_t k = submitted++;
+            {
+                std::lock_guard<std::mutex> lock(batch.mutex);
+                batch.inFlight++;
+            }
+            pool.submit([&batch, input, chunk = chunks[k], k]() {
+                std::exception_ptr error;
+                try {
+                    parseChunk(input, chunk, [&](JsonDocument&& doc) {
+                        batch.results[k].push_back(std::move(doc));
+                    });
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                batch.finish(k, error);
+            });
+        };
+        size_t records = 0;
+        try {
+            while (submitted < chunks.size() && submitted < window) {
+                submitNext();
+            }
+            for (size_t k = 0; k < chunks.size(); k++) {
+                {
+                    std::unique_lock<std::mutex> lock(batch.mutex);
+                    batch.done.wait(lock, [&] { return batch.ready[k] || batch.error; });
+                    if (batch.error) {
+                        std::rethrow_exception(batch.error);
+                    }
+                }
+                for (JsonDocument& doc : batch.results[k]) {
+                    onRecord(doc);
+                    records++;
+                }
+                std::vector<JsonDocument>().swap(batch.results[k]);
+                if (submitted < chunks.size()) {
+                    submitNext();
+                }
+            }
+        } catch (...) {
+            batch.waitIdle();
+            throw;
+        }
+        return records;
+    }
+
+    // onRecord(JsonDocument&) runs concurrently on the workers in no
+    // particular order and must be thread safe
+    template <typename F>
+    size_t parseUnordered(std::string_view input, F&& onRecord) {
+        std::vector<Chunk> chunks = split(input);
+        Batch batch;
+        batch.ready.assign(chunks.size(), 0);
+        batch.inFlight = chunks.size();
+        std::atomic<size_t> records{0};
+        for (size_t k = 0; k < chunks.size(); k++) {
+            pool.submit([&, chunk = chunks[k], k]() {
+                std::exception_ptr error;
+                try {
+                    parseChunk(input, chunk, [&](JsonDocument&& doc) {
+                        onRecord(doc);
+                        records.fetch_add(1, std::memory_order_relaxed);
+                    });
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                batch.finish(k, error);
+            });
+        }
+        batch.waitIdle();
+        if (batch.error) {
+            std::rethrow_exception(batch.error);
+        }
+        return records.load();
+    }
+
+    template <typename F>
+    size_t parseFile(const std::string& path, F&& onRecord, bool ordered = true) {
+        MappedFile file(path);
+        return ordered ? parse(file.view(), onRecord) : parseUnordered(file.view(), onRecord);
+    }
+
+    size_t threads() const { return pool.size(); }
+};
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+// locale independent number parsing and formatting
+//
+// parse() follows the JSON grammar exactly and keeps integers that fit in
+// int64/uint64 as integers. decimals with at most 19 significant digits and
+// a small exponent are converted with one exactly rounded multiply or divide
+// (Clinger's fast path), everything else goes to std::from_chars, which in
+// libstdc++ 12 is the Eisel-Lemire algorithm from fast_float. formatting
+// uses std::to_chars, the shortest text that reads back to the same double.
+
+namespace jsonnum {
+
+enum class NumberType : uint8_t { Int64, Uint64, Double };
+
+struct Number {
+    NumberType type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+    };
+
+    double toDouble() const {
+        switch (type) {
+            case NumberType::Int64: return double(i);
+            case NumberType::Uint64: return double(u);
+            default: return d;
+        }
+    }
+};
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// 10^0 .. 10^22 are exact doubles
+inline double exactPow10(int e) {
+    static constexpr double table[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    return table[e];
+}
+
+// parses the number at p, returns the end of it or nullptr if the text is
+// not a JSON number (or overflows a double)
+inline const char* parse(const char* p, const char* end, Number& out) {
+    const char* start = p;
+    bool negative = p < end && *p == '-';
+    if (negative) {
+        p++;
+    }
+    if (p == end || !isDigit(*p)) {
+        return nullptr;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0;         // significant digits in mantissa
+    bool truncated = false; // more digits than fit in 19
+    bool integerOverflow = false;
+    int64_t exponent = 0;
+    if (*p == '0') {
+        p++; // no leading zeros, "01" ends after the 0
+    } else {
+        while (p < end && isDigit(*p)) {
+            uint64_t d = *p - '0';
+            if (__builtin_mul_overflow(mantissa, 10, &mantissa) ||
+                __builtin_add_overflow(mantissa, d, &mantissa)) {
+                integerOverflow = true;
+            }
+            digits++;
+            p++;
+        }
+    }
+    bool isInteger = true;
+    if (p < end && *p == '.') {
+        isInteger = false;
+        p++;
+        if (p == end || !isDigit(*p)) {
+            return nullptr;
+        }
+        while (p < end && isDigit(*p)) {
+            uint64_t d = *p - '0';
+            if (digits < 19) {
+                if (mantissa != 0 || d != 0) {
+                    mantissa = mantissa * 10 + d;
+                    digits++;
+                }
+                exponent--;
+            } else if (d != 0) {
+                truncated = true;
+            }
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        isInteger = false;
+        p++;
+        bool negativeExponent = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+')) {
+            p++;
+        }
+        if (p == end || !isDigit(*p)) {
+            return nullptr;
+        }
+        int64_t e = 0;
+        while (p < end && isDigit(*p)) {
+            if (e < 1000000) {
+                e = e * 10 + (*p - '0');
+            }
+            p++;
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+    if (isInteger && !integerOverflow && !(negative && mantissa == 0)) {
+        if (!negative && mantissa > uint64_t(std::numeric_limits<int64_t>::max())) {
+            out.type = NumberType::Uint64;
+            out.u = mantissa;
+            return p;
+        }
+        if (!negative || mantissa <= uint64_t(1) << 63) {
+            out.type = NumberType::Int64;
+            out.i = negative ? int64_t(0 - mantissa) : int64_t(mantissa);
+            return p;
+        }
+    }
+    out.type = NumberType::Double;
+    if (!integerOverflow && digits <= 19 && !truncated && mantissa <= (uint64_t(1) << 53) &&
+        exponent >= -22 && exponent <= 22) {
+        double d = double(mantissa);
+        d = exponent < 0 ? d / exactPow10(-exponent) : d * exactPow10(exponent);
+        out.d = negative ? -d : d;
+        return p;
+    }
+    auto [last, ec] = std::from_chars(start, p, out.d);
+    if (ec == std::errc::result_out_of_range && exponent < 0) {
+        out.d = negative ? -0.0 : 0.0; // underflow rounds to zero
+    } else if (ec != std::errc() || last != p) {
+        return nullptr;
+    }
+    return p;
+}
+
+// n as an integer type I, false if it does not fit. whole doubles such as
+// 16.0 are accepted, the same rule for jsonbind and OnDemand
+template <typename I>
+bool toInteger(const Number& n, I& out) {
+    using Limits = std::numeric_limits<I>;
+    switch (n.type) {
+        case NumberType::Int64:
+            out = I(n.i);
+            return std::is_signed_v<I> ? n.i >= int64_t(Limits::min()) && n.i <= int64_t(Limits::max())
+                                       : n.i >= 0 && uint64_t(n.i) <= uint64_t(Limits::max());
+        case NumberType::Uint64:
+            out = I(n.u);
+            return n.u <= uint64_t(Limits::max());
+        default: {
+            // both bounds are exact doubles
+            double low = double(Limits::min());
+            double high = 2.0 * double(I(1) << (Limits::digits - 1));
+            bool fits = n.d == std::floor(n.d) && n.d >= low && n.d < high;
+            out = fits ? I(n.d) : I(0);
+            return fits;
+        }
+    }
+}
+
+inline const char* parseDouble(const char* p, const char* end, double& out) {
+    Number n;
+    const char* last = parse(p, end, n);
+    if (last != nullptr) {
+        out = n.toDouble();
+    }
+    return last;
+}
+
+// longest output is 24 characters
+constexpr size_t MAX_CHARS = 32;
+
+// shortest text that parses back to v, "null" for NaN and infinities which
+// JSON cannot represent
+inline char* format(double v, char* out) {
+    if (!std::isfinite(v)) {
+        return std::copy_n("null", 4, out);
+    }
+    return std::to_chars(out, out + MAX_CHARS, v).ptr;
+}
+
+inline char* format(int64_t v, char* out) {
+    return std::to_chars(out, out + MAX_CHARS, v).ptr;
+}
+
+inline char* format(uint64_t v, char* out) {
+    return std::to_chars(out, out + MAX_CHARS, v).ptr;
+}
+
+template <typename T>
+inline void append(T v, std::string& out) {
+    char buf[MAX_CHARS];
+    out.append(buf, format(v, buf) - buf);
+}
+
+} // namespace jsonnum
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// object members in insertion order
+//
+// members live in one vector of (key, value) pairs, so iteration is a
+// linear walk and stringify writes keys back in the order they were read.
+// next to the members is a vector of 8 byte tags, the key's last 8 bytes
+// mixed with its length, so objects up to LINEAR_LIMIT members are searched
+// by scanning the tags without touching the members. past that an open
+// addressing table of member positions is built and kept up to date on
+// insert, so const lookups never modify the object and stay safe to share
+// between threads.
+//
+// the interface is the subset of std::map the parsers and callers use, but
+// references and iterators follow std::vector rules: any insert or erase
+// may move every member. obj["a"] = obj["b"] reads a dangling reference
+// when "a" is new, copy the value out first. keys must not be changed
+// through iterators, the table would not notice.
+template <typename Value>
+class JsonMembers {
+public:
+    using value_type = std::pair<std::string, Value>;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    static constexpr size_t LINEAR_LIMIT = 16;
+
+private:
+    std::vector<value_type> members;
+    std::vector<uint64_t> tags;
+    // position + 1 of a member, 0 for an empty slot, size is a power of two
+    std::vector<uint32_t> slots;
+
+    static size_t hash(std::string_view key) { return std::hash<std::string_view>{}(key); }
+
+    static uint64_t tag(std::string_view key) {
+        uint64_t t = 0;
+        size_t n = std::min<size_t>(key.size(), 8);
+        if (n) {
+            std::memcpy(&t, key.data() + key.size() - n, n);
+        }
+        return t ^ (uint64_t(key.size()) << 56);
+    }
+
+    bool matches(size_t i, uint64_t t, std::string_view key) const {
+        return tags[i] == t && members[i].first == key;
+    }
+
+    size_t position(std::string_view key) const {
+        uint64_t t = tag(key);
+        if (slots.empty()) {
+            for (size_t i = 0; i < tags.size(); i++) {
+                if (matches(i, t, key)) {
+                    return i;
+                }
+            }
+            return members.size();
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t s = hash(key) & mask; slots[s]; s = (s + 1) & mask) {
+            if (matches(slots[s] - 1, t, key)) {
+                return slots[s] - 1;
+            }
+        }
+        return members.size();
+    }
+
+    void place(size_t i) {
+        size_t mask = slots.size() - 1;
+        size_t s = hash(members[i].first) & mask;
+        while (slots[s]) {
+            s = (s + 1) & mask;
+        }
+        slots[s] = uint32_t(i + 1);
+    }
+
+    // at most half full, rebuilt from scratch when it has to grow
+    void reindex() {
+        slots.clear();
+        if (members.size() <= LINEAR_LIMIT) {
+            return;
+        }
+        size_t n = 32;
+        while (n < members.size() * 2) {
+            n *= 2;
+        }
+        slots.assign(n, 0);
+        for (size_t i = 0; i < members.size(); i++) {
+            place(i);
+        }
+    }
+
+    template <typename K, typename... Args>
+    iterator append(K&& key, Args&&... args) {
+        if (members.empty()) {
+            reserve(4);
+        }
+        members.emplace_back(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                             std::forward_as_tuple(std::forward<Args>(args)...));
+        tags.push_back(tag(members.back().first));
+        if (members.size() * 2 > slots.size()) {
+            reindex();
+        } else {
+            place(members.size() - 1);
+        }
+        return members.end() - 1;
+    }
+
+public:
+    JsonMembers() = default;
+    JsonMembers(std::initializer_list<value_type> init) {
+        for (const value_type& m : init) {
+            insert(m);
+        }
+    }
+
+    iterator begin() { return members.begin(); }
+    iterator end() { return members.end(); }
+    const_iterator begin() const { return members.begin(); }
+    const_iterator end() const { return members.end(); }
+    size_t size() const { return members.size(); }
+    bool empty() const { return members.empty(); }
+    void reserve(size_t n) {
+        members.reserve(n);
+        tags.reserve(n);
+    }
+
+    void clear() {
+        members.clear();
+        tags.clear();
+        slots.clear();
+    }
+
+    iterator find(std::string_view key) { return members.begin() + position(key); }
+    const_iterator find(std::string_view key) const { return members.begin() + position(key); }
+    size_t count(std::string_view key) const { return position(key) < members.size(); }
+    bool contains(std::string_view key) const { return count(key) != 0; }
+
+    // std::out_of_range like std::map::at
+    Value& at(std::string_view key) {
+        size_t i = position(key);
+        if (i == members.size()) {
+            throw std::out_of_range("Key not found");
+        }
+        return members[i].second;
+    }
+    const Value& at(std::string_view key) const {
+        size_t i = position(key);
+        if (i == members.size()) {
+            throw std::out_of_range("Key not found");
+        }
+        return members[i].second;
+    }
+
+    // a new key is appended, an existing one keeps its place
+    template <typename K>
+    Value& operator[](K&& key) {
+        size_t i = position(key);
+        if (i < members.size()) {
+            return members[i].second;
+        }
+        return append(std::forward<K>(key))->second;
+    }
+
+    template <typename K, typename V>
+    std::pair<iterator, bool> emplace(K&& key, V&& value) {
+        size_t i = position(key);
+        if (i < members.size()) {
+            return {members.begin() + i, false};
+        }
+        return {append(std::forward<K>(key), std::forward<V>(value)), true};
+    }
+
+    std::pair<iterator, bool> insert(const value_type& m) { return emplace(m.first, m.second); }
+    std::pair<iterator, bool> insert(value_type&& m) {
+        return emplace(std::move(m.first), std::move(m.second));
+    }
+
+    // later members move up one place, so the table is rebuilt
+    iterator erase(const_iterator it) {
+        tags.erase(tags.begin() + (it - members.begin()));
+        iterator next = members.erase(it);
+        if (!slots.empty()) {
+            reindex();
+        }
+        return next;
+    }
+
+    size_t erase(std::string_view key) {
+        size_t i = position(key);
+        if (i == members.size()) {
+            return 0;
+        }
+        erase(members.begin() + i);
+        return 1;
+    }
+};
@@ -0,0 +1,429 @@
+#pragma once
+
+#include "json_mmap.h"
+#include "json_number.h"
+#include "json_simd.h"
+#include "json_string.h"
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// lazy access to a document, only the values asked for are parsed
+//
+//     OnDemandDocument doc = OnDemandDocument::parse(text);
+//     double b = doc["a"]["b"].get<double>();
+//
+// a value is a position in the text. looking up a key scans the object's
+// members, resuming after the last match, and skips every value that does
+// not match without decoding it: strings by memchr for the closing quote,
+// containers 64 bytes at a time with the stage 1 classifiers, counting
+// brackets outside strings. nothing is allocated except strings with
+// escapes that are read as views. the flip side is that only the parts that
+// are walked are checked, a syntax error in a skipped subtree goes
+// unnoticed. lookups move a cursor inside the document, so one document is
+// read by one thread.
+
+class OnDemandDocument;
+
+namespace jsonondemand {
+
+struct BracketMasks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t open;  // { [
+    uint64_t close; // } ]
+};
+
+inline BracketMasks classifyScalar(const char* block) {
+    BracketMasks m{0, 0, 0, 0};
+    for (int i = 0; i < 64; i++) {
+        uint64_t bit = uint64_t(1) << i;
+        char lower = block[i] | 0x20;
+        if (block[i] == '"') { m.quote |= bit; }
+        if (block[i] == '\\') { m.backslash |= bit; }
+        if (lower == '{') { m.open |= bit; }
+        if (lower == '}') { m.close |= bit; }
+    }
+    return m;
+}
+
+__attribute__((target("sse4.2")))
+inline BracketMasks classifySse42(const char* block) {
+    BracketMasks m{0, 0, 0, 0};
+    for (int i = 0; i < 4; i++) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+        __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+        int shift = 16 * i;
+        m.quote |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'))))) << shift;
+        m.backslash |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))))) << shift;
+        m.open |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{'))))) << shift;
+        m.close |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))))) << shift;
+    }
+    return m;
+}
+
+__attribute__((target("avx2")))
+inline BracketMasks classifyAvx2(const char* block) {
+    BracketMasks m{0, 0, 0, 0};
+    for (int i = 0; i < 2; i++) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * i));
+        __m256i lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+        int shift = 32 * i;
+        m.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(jsonsimd::eq(chunk, '"')))) << shift;
+        m.backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(jsonsimd::eq(chunk, '\\')))) << shift;
+        m.open |= uint64_t(uint32_t(_mm256_movemask_epi8(jsonsimd::eq(lower, '{')))) << shift;
+        m.close |= uint64_t(uint32_t(_mm256_movemask_epi8(jsonsimd::eq(lower, '}')))) << shift;
+    }
+    return m;
+}
+
+// p is just after an opening bracket, outside any string. returns the
+// position after the bracket that closes it
+template <BracketMasks (*Classify)(const char*)>
+__attribute__((always_inline)) inline const char* skipBlocks(const char* p, const char* end) {
+    jsonsimd::StringScanner scanner;
+    uint64_t depth = 1;
+    while (p < end) {
+        char padded[64];
+        const char* block = p;
+        if (end - p < 64) {
+            std::memset(padded, ' ', sizeof(padded));
+            std::memcpy(padded, p, end - p);
+            block = padded;
+        }
+        BracketMasks m = Classify(block);
+        uint64_t quotes;
+        uint64_t inString = scanner.strings(m.quote, m.backslash, quotes);
+        uint64_t open = m.open & ~inString;
+        uint64_t close = m.close & ~inString;
+        uint64_t closes = __builtin_popcountll(close);
+        if (closes < depth) {
+            // depth cannot reach zero inside this block
+            depth += __builtin_popcountll(open) - closes;
+        } else {
+            for (uint64_t bits = open | close; bits != 0; bits &= bits - 1) {
+                uint64_t bit = bits & (0 - bits);
+                if (open & bit) {
+                    depth++;
+                } else if (--depth == 0) {
+                    return p + __builtin_ctzll(bit) + 1;
+                }
+            }
+        }
+        p += 64;
+    }
+    throw std::runtime_error("Unexpected end of input");
+}
+
+__attribute__((target("avx2")))
+inline const char* skipAvx2(const char* p, const char* end) { return skipBlocks<classifyAvx2>(p, end); }
+
+__attribute__((target("sse4.2")))
+inline const char* skipSse42(const char* p, const char* end) { return skipBlocks<classifySse42>(p, end); }
+
+inline const char* skipScalar(const char* p, const char* end) { return skipBlocks<classifyScalar>(p, end); }
+
+inline const char* skipContainer(const char* p, const char* end) {
+    static const auto skip = [] {
+        switch (jsonsimd::detectIsa()) {
+            case jsonsimd::Isa::Avx2: return skipAvx2;
+            case jsonsimd::Isa::Sse42: return skipSse42;
+            default: return skipScalar;
+        }
+    }();
+    return skip(p, end);
+}
+
+// p is on the opening quote, returns the closing quote
+inline const char* findStringEnd(const char* p, const char* end) {
+    const char* q = p + 1;
+    while (true) {
+        q = static_cast<const char*>(std::memchr(q, '"', end - q));
+        if (q == nullptr) {
+            throw std::runtime_error("Unterminated string literal");
+        }
+        // escaped if preceded by an odd number of backslashes
+        const char* b = q;
+        while (b > p + 1 && b[-1] == '\\') {
+            b--;
+        }
+        if ((q - b) % 2 == 0) {
+            return q;
+        }
+        q++;
+    }
+}
+
+inline const char* skipWhitespace(const char* p, const char* end) {
+    while (p < end && jsonsimd::isWhitespace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// p is on the first character of a value, returns the position after it
+inline const char* skipValue(const char* p, const char* end) {
+    switch (*p) {
+        case '"': return findStringEnd(p, end) + 1;
+        case '{': case '[': return skipContainer(p + 1, end);
+        default: {
+            const char* q = p;
+            while (q < end && !jsonsimd::isWhitespace(*q) && !jsonsimd::isOp(*q)) {
+                q++;
+            }
+            if (q == p) {
+                throw std::runtime_error("Unexpected character");
+            }
+            return q;
+        }
+    }
+}
+
+// compares a raw key (between the quotes) with a decoded one
+inline bool keyEquals(std::string_view raw, std::string_view key) {
+    if (std::memchr(raw.data(), '\\', raw.size()) == nullptr) {
+        return raw == key;
+    }
+    std::string decoded;
+    std::string quoted(raw);
+    quoted += '"';
+    jsonstr::decode(quoted.data(), quoted.data() + quoted.size(), decoded);
+    return decoded == key;
+}
+
+} // namespace jsonondemand
+
+class OnDemandValue {
+private:
+    const OnDemandDocument* doc;
+    const char* p; // first character of the value
+    const char* end;
+
+    OnDemandValue(const OnDemandDocument* doc, const char* p, const char* end) : doc(doc), p(p), end(end) {}
+    friend class OnDemandDocument;
+
+    const char* next(const char* q) const {
+        q = jsonondemand::skipWhitespace(q, end);
+        if (q == end) {
+            throw std::runtime_error("Unexpected end of input");
+        }
+        return q;
+    }
+
+    jsonnum::Number number() const {
+        if (!isNumber()) throw std::runtime_error("Type is not number");
+        jsonnum::Number n;
+        jsonsimd::parseNumber(p, end, n);
+        return n;
+    }
+
+public:
+    bool isNull() const { return *p == 'n'; }
+    bool isBool() const { return *p == 't' || *p == 'f'; }
+    bool isNumber() const { return *p == '-' || jsonnum::isDigit(*p); }
+    bool isString() const { return *p == '"'; }
+    bool isArray() const { return *p == '['; }
+    bool isObject() const { return *p == '{'; }
+
+    // member lookup. the scan resumes at the member found last in this
+    // object and wraps around, so keys read in document order cost one pass
+    std::optional<OnDemandValue> find(std::string_view key) const;
+
+    OnDemandValue operator[](std::string_view key) const {
+        std::optional<OnDemandValue> v = find(key);
+        if (!v) throw std::runtime_error("Key not found");
+        return *v;
+    }
+
+    // n-th element, skips the ones before it
+    OnDemandValue at(size_t n) const {
+        if (!isArray()) throw std::runtime_error("Type is not array");
+        const char* q = next(p + 1);
+        if (*q != ']') {
+            for (size_t i = 0;; i++) {
+                if (i == n) {
+                    return OnDemandValue(doc, q, end);
+                }
+                q = next(jsonondemand::skipValue(q, end));
+                if (*q == ']') {
+                    break;
+                }
+                if (*q != ',') throw std::runtime_error("Expected ',' or ']'");
+                q = next(q + 1);
+            }
+        }
+        throw std::runtime_error("Index out of range");
+    }
+    OnDemandValue operator[](size_t n) const { return at(n); }
+
+    // calls f(OnDemandValue) for each element
+    template <typename F>
+    void forEach(F&& f) const {
+        if (!isArray()) throw std::runtime_error("Type is not array");
+        const char* q = next(p + 1);
+        if (*q == ']') {
+            return;
+        }
+        while (true) {
+            f(OnDemandValue(doc, q, end));
+            q = next(jsonondemand::skipValue(q, end));
+            if (*q == ']') {
+                return;
+            }
+            if (*q != ',') throw std::runtime_error("Expected ',' or ']'");
+            q = next(q + 1);
+        }
+    }
+
+    // calls f(key, OnDemandValue) for each member, raw keys with escapes
+    // are decoded
+    template <typename F>
+    void forEachMember(F&& f) const;
+
+    // double, float, integers (range checked, 16.0 counts), bool, std::string,
+    // std::string_view (valid as long as the document)
+    template <typename T>
+    T get() const;
+
+    // the text of the value
+    std::string_view raw() const { return {p, size_t(jsonondemand::skipValue(p, end) - p)}; }
+};
+
+class OnDemandDocument {
+private:
+    std::string_view text;
+    std::shared_ptr<const MappedFile> source;
+    mutable std::deque<std::string> decoded; // strings with escapes read as views
+    mutable const char* cursorObject = nullptr;
+    mutable const char* cursorMember = nullptr;
+
+    friend class OnDemandValue;
+
+    std::string_view keep(std::string s) const {
+        decoded.push_back(std::move(s));
+        return decoded.back();
+    }
+
+public:
+    // text must outlive the document
+    static OnDemandDocument parse(std::string_view text) {
+        OnDemandDocument doc;
+        doc.text = text;
+        return doc;
+    }
+
+    static OnDemandDocument parseFromFile(const std::string& path) {
+        OnDemandDocument doc;
+        doc.source = std::make_shared<const MappedFile>(path);
+        doc.text = doc.source->view();
+        return doc;
+    }
+
+    OnDemandValue root() const {
+        const char* end = text.data() + text.size();
+        const char* p = jsonondemand::skipWhitespace(text.data(), end);
+        if (p == end) {
+            throw std::runtime_error("Unexpected end of input");
+        }
+        return OnDemandValue(this, p, end);
+    }
+
+    OnDemandValue operator[](std::string_view key) const { return root()[key]; }
+};
+
+inline std::optional<OnDemandValue> OnDemandValue::find(std::string_view key) const {
+    if (!isObject()) throw std::runtime_error("Type is not object");
+    const char* first = next(p + 1);
+    if (*first == '}') {
+        return std::nullopt;
+    }
+    const char* start = doc->cursorObject == p ? doc->cursorMember : first;
+    const char* q = start;
+    bool wrapped = false;
+    while (!wrapped || q != start) {
+        if (*q != '"') throw std::runtime_error("Expected string key");
+        const char* keyEnd = jsonondemand::findStringEnd(q, end);
+        bool match = jsonondemand::keyEquals(std::string_view(q + 1, keyEnd - q - 1), key);
+        const char* value = next(keyEnd + 1);
+        if (*value != ':') throw std::runtime_error("Expected ':'");
+        value = next(value + 1);
+        if (match) {
+            doc->cursorObject = p;
+            doc->cursorMember = q;
+            return OnDemandValue(doc, value, end);
+        }
+        q = next(jsonondemand::skipValue(value, end));
+        if (*q == '}') {
+            if (start == first || wrapped) {
+                break;
+            }
+            wrapped = true;
+            q = first;
+            continue;
+        }
+        if (*q != ',') throw std::runtime_error("Expected ',' or '}'");
+        q = next(q + 1);
+    }
+    return std::nullopt;
+}
+
+template <typename F>
+void OnDemandValue::forEachMember(F&& f) const {
+    if (!isObject()) throw std::runtime_error("Type is not object");
+    const char* q = next(p + 1);
+    if (*q == '}') {
+        return;
+    }
+    while (true) {
+        if (*q != '"') throw std::runtime_error("Expected string key");
+        OnDemandValue key(doc, q, end);
+        q = next(jsonondemand::findStringEnd(q, end) + 1);
+        if (*q != ':') throw std::runtime_error("Expected ':'");
+        q = next(q + 1);
+        f(key.get<std::string_view>(), OnDemandValue(doc, q, end));
+        q = next(jsonondemand::skipValue(q, end));
+        if (*q == '}') {
+            return;
+        }
+        if (*q != ',') throw std::runtime_error("Expected ',' or '}'");
+        q = next(q + 1);
+    }
+}
+
+template <typename T>
+T OnDemandValue::get() const {
+    if constexpr (std::is_same_v<T, bool>) {
+        if (!isBool()) throw std::runtime_error("Type is not bool");
+        jsonsimd::expectLiteral(p, end, *p == 't' ? "true" : "false");
+        return *p == 't';
+    } else if constexpr (std::is_floating_point_v<T>) {
+        return T(number().toDouble());
+    } else if constexpr (std::is_integral_v<T>) {
+        T out;
+        if (!jsonnum::toInteger(number(), out)) throw std::runtime_error("Number out of range");
+        return out;
+    } else if constexpr (std::is_same_v<T, std::string_view> || std::is_same_v<T, std::string>) {
+        if (!isString()) throw std::runtime_error("Type is not string");
+        // validates the UTF-8 of the run, escapes are decoded from there
+        const char* q = jsonstr::scan(p + 1, end);
+        if (*q == '"') {
+            return T(std::string_view(p + 1, q - p - 1));
+        }
+        std::string s(p + 1, q - p - 1);
+        jsonstr::decode(q, end, s);
+        if constexpr (std::is_same_v<T, std::string>) {
+            return s;
+        } else {
+            return doc->keep(std::move(s));
+        }
+    } else {
+        static_assert(std::is_same_v<T, void>, "Unsupported type for get");
+    }
+}
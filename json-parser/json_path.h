@@ -0,0 +1,474 @@
+#pragma once
+
+#include "json.h"
+#include "json_sax.h"
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// compiled queries: RFC 6901 JSON Pointer and a JSONPath subset
+//
+//     JsonPath p = JsonPath::pointer("/users/0/name");
+//     JsonPath q = JsonPath::compile("$.users[*].emails[0:2]");
+//
+// supported JSONPath: $ . .name .* ['name'] ["name"] [n] [-n] [*]
+// [start:end:step] with a positive step, and .. before any of them for
+// recursive descent. a path is parsed once into a list of steps and can be
+// evaluated against a JsonValue tree (select, first) or against a streaming
+// parse (JsonPathMatcher), where only matching subtrees are built into
+// JsonValues. on the tree, plain member steps are map lookups and branches
+// that cannot match are never entered.
+
+class JsonPath {
+public:
+    struct Step {
+        enum class Kind : uint8_t { Name, Index, Wildcard, Slice };
+        Kind kind = Kind::Name;
+        bool descendant = false; // .. before the selector
+        std::string name;        // Name
+        int64_t index = -1;      // Index; for pointer tokens the array index, or -1
+        int64_t start = 0;       // Slice
+        int64_t end = 0;
+        int64_t step = 1;
+        bool hasStart = false;
+        bool hasEnd = false;
+    };
+
+private:
+    std::vector<Step> steps;
+
+    [[noreturn]] static void fail(const char* what, size_t pos) {
+        throw std::runtime_error(std::string(what) + " at " + std::to_string(pos));
+    }
+
+    static bool parseInt(std::string_view s, int64_t& out) {
+        size_t i = s.size() > 0 && s[0] == '-' ? 1 : 0;
+        if (i == s.size() || s.size() - i > 18) {
+            return false;
+        }
+        int64_t v = 0;
+        for (size_t k = i; k < s.size(); k++) {
+            if (!jsonnum::isDigit(s[k])) {
+                return false;
+            }
+            v = v * 10 + (s[k] - '0');
+        }
+        out = i ? -v : v;
+        return true;
+    }
+
+    // [...] at path[pos] == '[', returns the position after ']'
+    static size_t parseBracket(std::string_view path, size_t pos, Step& step) {
+        size_t close;
+        pos++;
+        if (pos < path.size() && (path[pos] == '\'' || path[pos] == '"')) {
+            char quote = path[pos];
+            size_t i = pos + 1;
+            for (; i < path.size() && path[i] != quote; i++) {
+                if (path[i] == '\\') {
+                    if (++i == path.size()) {
+                        break;
+                    }
+                }
+                step.name += path[i];
+            }
+            if (i + 1 >= path.size() || path[i + 1] != ']') {
+                fail("Unterminated name in JSON path", pos);
+            }
+            step.kind = Step::Kind::Name;
+            return i + 2;
+        }
+        close = path.find(']', pos);
+        if (close == std::string_view::npos) {
+            fail("Expected ']' in JSON path", pos);
+        }
+        std::string_view inside = path.substr(pos, close - pos);
+        if (inside == "*") {
+            step.kind = Step::Kind::Wildcard;
+            return close + 1;
+        }
+        size_t colon = inside.find(':');
+        if (colon == std::string_view::npos) {
+            if (!parseInt(inside, step.index)) {
+                fail("Invalid index in JSON path", pos);
+            }
+            step.kind = Step::Kind::Index;
+            return close + 1;
+        }
+        step.kind = Step::Kind::Slice;
+        std::string_view startText = inside.substr(0, colon);
+        std::string_view rest = inside.substr(colon + 1);
+        size_t colon2 = rest.find(':');
+        std::string_view endText = rest.substr(0, colon2);
+        std::string_view stepText = colon2 == std::string_view::npos ? "" : rest.substr(colon2 + 1);
+        step.hasStart = !startText.empty();
+        step.hasEnd = !endText.empty();
+        if ((step.hasStart && !parseInt(startText, step.start)) ||
+            (step.hasEnd && !parseInt(endText, step.end)) ||
+            (!stepText.empty() && !parseInt(stepText, step.step))) {
+            fail("Invalid slice in JSON path", pos);
+        }
+        if (step.step <= 0) {
+            fail("Slice step must be positive in JSON path", pos);
+        }
+        return close + 1;
+    }
+
+    // resolves the slice bounds for an array of length n
+    static void sliceBounds(const Step& s, int64_t n, int64_t& start, int64_t& end) {
+        start = s.hasStart ? s.start : 0;
+        end = s.hasEnd ? s.end : n;
+        if (start < 0) start += n;
+        if (end < 0) end += n;
+        start = std::max<int64_t>(0, std::min(start, n));
+        end = std::max<int64_t>(0, std::min(end, n));
+    }
+
+    template <typename F>
+    bool visit(const JsonValue& v, size_t i, F& onMatch) const {
+        if (i == steps.size()) {
+            return onMatch(v);
+        }
+        const Step& s = steps[i];
+        if (v.isObject()) {
+            const JsonObject& obj = v.getObject();
+            if (s.kind == Step::Kind::Name && !s.descendant) {
+                auto it = obj.find(s.name);
+                return it == obj.end() || visit(it->second, i + 1, onMatch);
+            }
+            for (const auto& member : obj) {
+                if (matchKey(s, member.first) && !visit(member.second, i + 1, onMatch)) {
+                    return false;
+                }
+                if (s.descendant && !visit(member.second, i, onMatch)) {
+                    return false;
+                }
+            }
+        } else if (v.isArray()) {
+            const JsonArray& arr = v.getArray();
+            int64_t n = int64_t(arr.size());
+            if (!s.descendant && (s.kind == Step::Kind::Index || s.kind == Step::Kind::Name)) {
+                int64_t k = s.kind == Step::Kind::Index && s.index < 0 ? s.index + n : s.index;
+                return k < 0 || k >= n || visit(arr[k], i + 1, onMatch);
+            }
+            int64_t start = 0;
+            int64_t end = 0;
+            if (s.kind == Step::Kind::Slice) {
+                sliceBounds(s, n, start, end);
+            }
+            for (int64_t k = 0; k < n; k++) {
+                if (matchIndex(s, k, n, start, end) && !visit(arr[k], i + 1, onMatch)) {
+                    return false;
+                }
+                if (s.descendant && !visit(arr[k], i, onMatch)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+public:
+    // JSONPath subset, must start with $
+    static JsonPath compile(std::string_view path) {
+        JsonPath result;
+        if (path.empty() || path[0] != '$') {
+            fail("JSON path must start with '$'", 0);
+        }
+        size_t pos = 1;
+        while (pos < path.size()) {
+            Step step;
+            if (path.compare(pos, 2, "..") == 0) {
+                step.descendant = true;
+                pos += 2;
+                if (pos < path.size() && path[pos] == '[') {
+                    pos = parseBracket(path, pos, step);
+                    result.steps.push_back(std::move(step));
+                    continue;
+                }
+            } else if (path[pos] == '.') {
+                pos++;
+            } else if (path[pos] == '[') {
+                pos = parseBracket(path, pos, step);
+                result.steps.push_back(std::move(step));
+                continue;
+            } else {
+                fail("Unexpected character in JSON path", pos);
+            }
+            size_t end = pos;
+            while (end < path.size() && path[end] != '.' && path[end] != '[') {
+                end++;
+            }
+            if (end == pos) {
+                fail("Expected a name in JSON path", pos);
+            }
+            std::string_view name = path.substr(pos, end - pos);
+            if (name == "*") {
+                step.kind = Step::Kind::Wildcard;
+            } else {
+                step.name = std::string(name);
+            }
+            result.steps.push_back(std::move(step));
+            pos = end;
+        }
+        return result;
+    }
+
+    // RFC 6901, "" is the whole document. a token matches an object member
+    // of that name or, if it is a canonical number, that array element
+    static JsonPath pointer(std::string_view pointer) {
+        JsonPath result;
+        if (!pointer.empty() && pointer[0] != '/') {
+            fail("JSON pointer must start with '/'", 0);
+        }
+        size_t pos = 0;
+        while (pos < pointer.size()) {
+            size_t end = pointer.find('/', pos + 1);
+            if (end == std::string_view::npos) {
+                end = pointer.size();
+            }
+            Step step;
+            for (size_t i = pos + 1; i < end; i++) {
+                if (pointer[i] != '~') {
+                    step.name += pointer[i];
+                } else if (i + 1 < end && (pointer[i + 1] == '0' || pointer[i + 1] == '1')) {
+                    step.name += pointer[++i] == '0' ? '~' : '/';
+                } else {
+                    fail("Invalid '~' escape in JSON pointer", i);
+                }
+            }
+            bool canonical = !step.name.empty() && (step.name == "0" || step.name[0] != '0');
+            if (!canonical || step.name[0] == '-' || !parseInt(step.name, step.index)) {
+                step.index = -1;
+            }
+            result.steps.push_back(std::move(step));
+            pos = end;
+        }
+        return result;
+    }
+
+    static bool matchKey(const Step& s, std::string_view key) {
+        return s.kind == Step::Kind::Wildcard || (s.kind == Step::Kind::Name && s.name == key);
+    }
+
+    // start and end are the resolved slice bounds
+    static bool matchIndex(const Step& s, int64_t k, int64_t n, int64_t start, int64_t end) {
+        switch (s.kind) {
+            case Step::Kind::Wildcard: return true;
+            case Step::Kind::Name: return s.index == k;
+            case Step::Kind::Index: return (s.index < 0 ? s.index + n : s.index) == k;
+            case Step::Kind::Slice: return k >= start && k < end && (k - start) % s.step == 0;
+        }
+        return false;
+    }
+
+    // calls onMatch(const JsonValue&) for every match in document order,
+    // stops early when it returns false
+    template <typename F>
+    void forEach(const JsonValue& root, F&& onMatch) const {
+        visit(root, 0, onMatch);
+    }
+
+    std::vector<const JsonValue*> select(const JsonValue& root) const {
+        std::vector<const JsonValue*> out;
+        forEach(root, [&](const JsonValue& v) { out.push_back(&v); return true; });
+        return out;
+    }
+
+    // first match or nullptr
+    const JsonValue* first(const JsonValue& root) const {
+        const JsonValue* found = nullptr;
+        forEach(root, [&](const JsonValue& v) { found = &v; return false; });
+        return found;
+    }
+
+    // runs a streaming parse of text, see JsonPathMatcher
+    template <typename F>
+    void stream(std::string_view text, F&& onMatch) const;
+
+    const std::vector<Step>& plan() const { return steps; }
+};
+
+// SAX handler that evaluates a path while JsonStreamParser runs and builds
+// only the matching values. the active steps per open container are a
+// bitmask, so containers no step can reach cost nothing but the parse.
+// negative indices and slice bounds need the array length and are not
+// supported here. a match is delivered when its value is complete, so a
+// match nested in another (with ..) arrives before the enclosing one.
+template <typename F>
+class JsonPathMatcher {
+private:
+    struct Frame {
+        uint64_t states;
+        bool array;
+        int64_t index; // of the next element
+        std::string key;
+    };
+
+    // a match being built, stack holds its open containers
+    struct Capture {
+        JsonValue value;
+        std::vector<JsonValue*> stack;
+        std::string key;
+    };
+
+    const JsonPath& path;
+    F onMatch;
+    size_t n;
+    std::vector<Frame> frames; // kept at their high water mark
+    size_t depth = 0;
+    std::deque<Capture> captures; // stacks point into the values, so no vector
+
+    uint64_t advance(uint64_t states, const Frame& parent) const {
+        uint64_t next = 0;
+        const std::vector<JsonPath::Step>& steps = path.plan();
+        for (; states != 0; states &= states - 1) {
+            size_t i = __builtin_ctzll(states);
+            if (i == n) {
+                continue;
+            }
+            const JsonPath::Step& s = steps[i];
+            bool match = parent.array
+                ? JsonPath::matchIndex(s, parent.index, INT64_MAX, s.hasStart ? s.start : 0, s.hasEnd ? s.end : INT64_MAX)
+                : JsonPath::matchKey(s, parent.key);
+            if (s.descendant) {
+                next |= uint64_t(1) << i;
+            }
+            if (match) {
+                next |= uint64_t(1) << (i + 1);
+            }
+        }
+        return next;
+    }
+
+    // states of the value that starts now, starts a capture if it matches
+    uint64_t beginValue() {
+        uint64_t states = 1;
+        if (depth > 0) {
+            Frame& parent = frames[depth - 1];
+            states = parent.states == 0 ? 0 : advance(parent.states, parent);
+            parent.index++;
+        }
+        if (states >> n & 1) {
+            captures.emplace_back();
+        }
+        return states;
+    }
+
+    // adds v to every capture, containers become the new innermost level
+    void append(JsonValue v, bool container) {
+        for (size_t k = 0; k < captures.size(); k++) {
+            Capture& c = captures[k];
+            JsonValue* slot;
+            if (c.stack.empty()) {
+                slot = &c.value;
+            } else if (c.stack.back()->isArray()) {
+                JsonArray& arr = std::get<JsonArray>(c.stack.back()->value);
+                slot = &arr.emplace_back();
+            } else {
+                slot = &std::get<JsonObject>(c.stack.back()->value)[c.key];
+            }
+            if (k + 1 == captures.size()) {
+                *slot = std::move(v);
+            } else {
+                *slot = v;
+            }
+            if (container) {
+                c.stack.push_back(slot);
+            }
+        }
+        if (!container) {
+            deliverComplete();
+        }
+    }
+
+    void deliverComplete() {
+        while (!captures.empty() && captures.back().stack.empty()) {
+            JsonValue v = std::move(captures.back().value);
+            captures.pop_back();
+            onMatch(static_cast<const JsonValue&>(v));
+        }
+    }
+
+    void open(bool array) {
+        uint64_t states = beginValue() & ~(uint64_t(1) << n);
+        append(array ? JsonValue{JsonArray{}} : JsonValue{JsonObject{}}, true);
+        if (depth == frames.size()) {
+            frames.emplace_back();
+        }
+        Frame& f = frames[depth++];
+        f.states = states;
+        f.array = array;
+        f.index = 0;
+    }
+
+    void close() {
+        depth--;
+        for (Capture& c : captures) {
+            c.stack.pop_back();
+        }
+        deliverComplete();
+    }
+
+    // true if the scalar that starts now is inside a match
+    bool beginScalar() {
+        beginValue();
+        return !captures.empty();
+    }
+
+public:
+    JsonPathMatcher(const JsonPath& path, F onMatch)
+        : path(path), onMatch(std::move(onMatch)), n(path.plan().size()) {
+        if (n >= 64) {
+            throw std::runtime_error("JSON path too long for streaming");
+        }
+        for (const JsonPath::Step& s : path.plan()) {
+            if ((s.kind == JsonPath::Step::Kind::Index && s.index < 0) ||
+                (s.kind == JsonPath::Step::Kind::Slice && ((s.hasStart && s.start < 0) || (s.hasEnd && s.end < 0)))) {
+                throw std::runtime_error("Negative array index needs the whole array");
+            }
+        }
+    }
+
+    void startObject() { open(false); }
+    void endObject() { close(); }
+    void startArray() { open(true); }
+    void endArray() { close(); }
+    void key(std::string_view k) {
+        frames[depth - 1].key.assign(k.data(), k.size());
+        for (Capture& c : captures) {
+            c.key.assign(k.data(), k.size());
+        }
+    }
+    void string(std::string_view s) {
+        if (beginScalar()) append({std::string(s)}, false);
+    }
+    void number(double v) {
+        if (beginScalar()) append({v}, false);
+    }
+    void number(int64_t v) {
+        if (beginScalar()) append({v}, false);
+    }
+    void number(uint64_t v) {
+        if (beginScalar()) append({v}, false);
+    }
+    void boolean(bool v) {
+        if (beginScalar()) append({v}, false);
+    }
+    void null() {
+        if (beginScalar()) append({nullptr}, false);
+    }
+};
+
+template <typename F>
+void JsonPath::stream(std::string_view text, F&& onMatch) const {
+    JsonPathMatcher<std::decay_t<F>> matcher(*this, std::forward<F>(onMatch));
+    JsonStreamParser<JsonPathMatcher<std::decay_t<F>>> parser(matcher);
+    parser.feed(text);
+    parser.finish();
+}
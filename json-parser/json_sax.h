@@ -0,0 +1,384 @@
+#pragma once
+
+#include "json_simd.h"
+#include "json_string.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// push parser for input that arrives in pieces or does not fit in memory
+//
+// feed() takes chunks of any size, split anywhere (mid-token, mid-escape,
+// mid-\uXXXX), and calls the handler as values complete. the parser keeps
+// one byte per open container plus the token in progress, so memory grows
+// with nesting depth and the longest string or number, never with the
+// document. strings that start and end inside one chunk without escapes are
+// passed to the handler as views into the chunk; views are only valid
+// during the callback. string bytes are validated as UTF-8 like in the
+// other parsers, also when a sequence is split between chunks.
+
+// no-op handler to derive from, the parser calls the methods by name so
+// there is no virtual dispatch. integers that fit are passed as int64_t or
+// uint64_t, a handler with only number(double) gets them converted
+struct JsonSaxHandler {
+    void startObject() {}
+    void endObject() {}
+    void startArray() {}
+    void endArray() {}
+    void key(std::string_view) {}
+    void string(std::string_view) {}
+    void number(double) {}
+    void number(int64_t) {}
+    void number(uint64_t) {}
+    void boolean(bool) {}
+    void null() {}
+};
+
+template <typename Handler>
+class JsonStreamParser {
+private:
+    enum class State : uint8_t {
+        Value,           // a value must follow
+        ValueOrEnd,      // after '['
+        KeyOrEnd,        // after '{'
+        Key,             // after ',' in an object
+        Colon,
+        CommaOrEnd,
+        String,
+        Escape,          // after '\'
+        Unicode,         // inside \uXXXX
+        SurrogateSlash,  // high surrogate seen, expecting '\'
+        SurrogateU,      // expecting 'u' of the low surrogate
+        Number,
+        Literal,
+        Done             // top level value complete
+    };
+
+    Handler& handler;
+    bool multipleValues;
+    size_t maxDepth;
+    State state = State::Value;
+    std::vector<char> stack; // '{' or '[' per open container
+    std::string token;       // string or number spanning chunks or escapes
+    bool tokenIsKey = false;
+    const char* literal = nullptr;
+    size_t literalPos = 0;
+    uint32_t unicode = 0;
+    int unicodeDigits = 0;
+    uint32_t highSurrogate = 0;
+    char partial[4];         // UTF-8 sequence cut by the end of a chunk
+    size_t partialSize = 0;
+    uint64_t offset = 0; // bytes consumed before the current chunk
+
+    [[noreturn]] void fail(const char* what, size_t i) {
+        throw std::runtime_error(std::string(what) + " at byte " + std::to_string(offset + i));
+    }
+
+    void endValue() {
+        state = stack.empty() ? State::Done : State::CommaOrEnd;
+    }
+
+    void emitString(std::string_view s) {
+        if (tokenIsKey) {
+            handler.key(s);
+            state = State::Colon;
+        } else {
+            handler.string(s);
+            endValue();
+        }
+    }
+
+    void startValue(char c, size_t i) {
+        switch (c) {
+            case '{': case '[': {
+                if (stack.size() >= maxDepth) {
+                    fail("Nesting too deep", i);
+                }
+                stack.push_back(c);
+                if (c == '{') {
+                    handler.startObject();
+                    state = State::KeyOrEnd;
+                } else {
+                    handler.startArray();
+                    state = State::ValueOrEnd;
+                }
+                break;
+            }
+            case '"': {
+                token.clear();
+                tokenIsKey = false;
+                state = State::String;
+                break;
+            }
+            case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9': {
+                token.assign(1, c);
+                state = State::Number;
+                break;
+            }
+            case 't': { literal = "true"; literalPos = 1; state = State::Literal; break; }
+            case 'f': { literal = "false"; literalPos = 1; state = State::Literal; break; }
+            case 'n': { literal = "null"; literalPos = 1; state = State::Literal; break; }
+            default: {
+                fail("Unexpected character", i);
+            }
+        }
+    }
+
+    void finishNumber(size_t i) {
+        jsonnum::Number value;
+        try {
+            jsonsimd::parseNumber(token.data(), token.data() + token.size(), value);
+        } catch (const std::runtime_error&) {
+            fail("Cannot parse number", i);
+        }
+        switch (value.type) {
+            case jsonnum::NumberType::Int64: handler.number(value.i); break;
+            case jsonnum::NumberType::Uint64: handler.number(value.u); break;
+            default: handler.number(value.d); break;
+        }
+        endValue();
+    }
+
+    // raw string bytes go to handlers as they are, so they are validated
+    // here. a sequence cut by the end of the chunk (more) is finished with
+    // the first bytes of the next one
+    void checkUtf8(const char* p, const char* end, bool more, size_t i) {
+        try {
+            if (partialSize > 0) {
+                char buf[4];
+                size_t take = std::min<size_t>(4 - partialSize, end - p);
+                std::memcpy(buf, partial, partialSize);
+                std::memcpy(buf + partialSize, p, take);
+                size_t length = partialSize + take;
+                if (more && p + take == end && jsonstr::incompleteTail(buf, buf + length) == length) {
+                    std::memcpy(partial, buf, length);
+                    partialSize = length;
+                    return;
+                }
+                size_t n = jsonstr::sequenceLength(reinterpret_cast<const unsigned char*>(buf),
+                                                   reinterpret_cast<const unsigned char*>(buf + length));
+                if (n == 0) {
+                    throw std::runtime_error("Invalid UTF-8 in string");
+                }
+                p += n - partialSize;
+                partialSize = 0;
+            }
+            size_t cut = more ? jsonstr::incompleteTail(p, end) : 0;
+            jsonstr::validate(p, end - cut);
+            std::memcpy(partial, end - cut, cut);
+            partialSize = cut;
+        } catch (const std::runtime_error&) {
+            fail("Invalid UTF-8 in string", i);
+        }
+    }
+
+    void closeContainer(char close, size_t i) {
+        char open = close == '}' ? '{' : '[';
+        if (stack.empty() || stack.back() != open) {
+            fail("Mismatched bracket", i);
+        }
+        stack.pop_back();
+        if (close == '}') {
+            handler.endObject();
+        } else {
+            handler.endArray();
+        }
+        endValue();
+    }
+
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    static bool isSpace(char c) { return jsonsimd::isWhitespace(c); }
+
+public:
+    // with multipleValues the input may hold any number of top level values,
+    // e.g. NDJSON
+    JsonStreamParser(Handler& handler, bool multipleValues = false, size_t maxDepth = 1024)
+        : handler(handler), multipleValues(multipleValues), maxDepth(maxDepth) {}
+
+    void feed(const char* data, size_t n) {
+        size_t i = 0;
+        while (i < n) {
+            char c = data[i];
+            switch (state) {
+                case State::Value: case State::ValueOrEnd: {
+                    if (isSpace(c)) { i++; break; }
+                    if (c == ']' && state == State::ValueOrEnd) {
+                        closeContainer(c, i);
+                    } else {
+                        startValue(c, i);
+                    }
+                    i++;
+                    break;
+                }
+                case State::KeyOrEnd: case State::Key: {
+                    if (isSpace(c)) { i++; break; }
+                    if (c == '}' && state == State::KeyOrEnd) {
+                        closeContainer(c, i);
+                    } else if (c == '"') {
+                        token.clear();
+                        tokenIsKey = true;
+                        state = State::String;
+                    } else {
+                        fail("Expected string key", i);
+                    }
+                    i++;
+                    break;
+                }
+                case State::Colon: {
+                    if (isSpace(c)) { i++; break; }
+                    if (c != ':') { fail("Expected ':'", i); }
+                    state = State::Value;
+                    i++;
+                    break;
+                }
+                case State::CommaOrEnd: {
+                    if (isSpace(c)) { i++; break; }
+                    if (c == ',') {
+                        state = stack.back() == '{' ? State::Key : State::Value;
+                    } else if (c == '}' || c == ']') {
+                        closeContainer(c, i);
+                    } else {
+                        fail(stack.back() == '{' ? "Expected ',' or '}'" : "Expected ',' or ']'", i);
+                    }
+                    i++;
+                    break;
+                }
+                case State::String: {
+                    // bulk scan to the next quote or backslash
+                    size_t run = i;
+                    unsigned char high = 0;
+                    while (i < n && data[i] != '"' && data[i] != '\\') { high |= data[i]; i++; }
+                    if ((high & 0x80) != 0 || partialSize > 0) {
+                        checkUtf8(data + run, data + i, i == n, run);
+                    }
+                    if (i == n) {
+                        token.append(data + run, i - run);
+                        break;
+                    }
+                    if (data[i] == '"') {
+                        if (token.empty()) {
+                            emitString(std::string_view(data + run, i - run));
+                        } else {
+                            token.append(data + run, i - run);
+                            emitString(token);
+                        }
+                    } else {
+                        token.append(data + run, i - run);
+                        state = State::Escape;
+                    }
+                    i++;
+                    break;
+                }
+                case State::Escape: {
+                    switch (c) {
+                        case '"': token += '"'; break;
+                        case '\\': token += '\\'; break;
+                        case '/': token += '/'; break;
+                        case 'b': token += '\b'; break;
+                        case 'f': token += '\f'; break;
+                        case 'n': token += '\n'; break;
+                        case 'r': token += '\r'; break;
+                        case 't': token += '\t'; break;
+                        case 'u': unicode = 0; unicodeDigits = 0; break;
+                        default: fail("Invalid escape sequence", i);
+                    }
+                    state = c == 'u' ? State::Unicode : State::String;
+                    i++;
+                    break;
+                }
+                case State::Unicode: {
+                    int v = hexValue(c);
+                    if (v < 0) { fail("Invalid \\u escape", i); }
+                    unicode = unicode << 4 | v;
+                    i++;
+                    if (++unicodeDigits < 4) { break; }
+                    if (highSurrogate != 0) {
+                        if (unicode < 0xdc00 || unicode > 0xdfff) { fail("Invalid surrogate pair", i); }
+                        jsonstr::appendUtf8(0x10000 + ((highSurrogate - 0xd800) << 10) + (unicode - 0xdc00), token);
+                        highSurrogate = 0;
+                        state = State::String;
+                    } else if (unicode >= 0xd800 && unicode <= 0xdbff) {
+                        highSurrogate = unicode;
+                        state = State::SurrogateSlash;
+                    } else if (unicode >= 0xdc00 && unicode <= 0xdfff) {
+                        fail("Invalid surrogate pair", i);
+                    } else {
+                        jsonstr::appendUtf8(unicode, token);
+                        state = State::String;
+                    }
+                    break;
+                }
+                case State::SurrogateSlash: case State::SurrogateU: {
+                    char expected = state == State::SurrogateSlash ? '\\' : 'u';
+                    if (c != expected) { fail("Invalid surrogate pair", i); }
+                    if (state == State::SurrogateSlash) {
+                        state = State::SurrogateU;
+                    } else {
+                        unicode = 0;
+                        unicodeDigits = 0;
+                        state = State::Unicode;
+                    }
+                    i++;
+                    break;
+                }
+                case State::Number: {
+                    if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+                        token += c;
+                        i++;
+                    } else {
+                        finishNumber(i); // c is looked at again in the next state
+                    }
+                    break;
+                }
+                case State::Literal: {
+                    if (c != literal[literalPos]) { fail("Cannot parse literal", i); }
+                    i++;
+                    if (literal[++literalPos] == '\0') {
+                        if (literal[0] == 'n') {
+                            handler.null();
+                        } else {
+                            handler.boolean(literal[0] == 't');
+                        }
+                        endValue();
+                    }
+                    break;
+                }
+                case State::Done: {
+                    if (isSpace(c)) { i++; break; }
+                    if (!multipleValues) { fail("Unexpected trailing characters", i); }
+                    startValue(c, i);
+                    i++;
+                    break;
+                }
+            }
+        }
+        offset += n;
+    }
+
+    void feed(std::string_view chunk) { feed(chunk.data(), chunk.size()); }
+
+    // call once the input is exhausted, completes a trailing number and
+    // checks that nothing is left open
+    void finish() {
+        if (state == State::Number) {
+            finishNumber(0);
+        }
+        bool empty = multipleValues && state == State::Value && stack.empty();
+        if (state != State::Done && !empty) {
+            throw std::runtime_error("Unexpected end of input at byte " + std::to_string(offset));
+        }
+    }
+
+    size_t depth() const { return stack.size(); }
+    uint64_t bytesConsumed() const { return offset; }
+};
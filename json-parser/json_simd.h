@@ -0,0 +1,405 @@
+#pragma once
+
+#include "json.h"
+#include "json_number.h"
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// two stage parsing in the style of simdjson
+//
+// stage 1 classifies the input 64 bytes at a time into bitmasks (quotes,
+// backslashes, structural characters, whitespace) and turns them into a
+// structural index: the offset of every { } [ ] : , outside of strings,
+// every opening quote and the first byte of every other scalar. escapes and
+// string interiors are resolved with carries between blocks, so there are no
+// per-byte branches. stage 2 walks the index instead of the bytes.
+//
+// the classifier is chosen at runtime: AVX2, SSE4.2 (pcmpestrm) or a scalar
+// loop, all three produce the same index.
+
+namespace jsonsimd {
+
+enum class Isa { Scalar, Sse42, Avx2 };
+
+inline Isa detectIsa() {
+    static const Isa isa = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) { return Isa::Avx2; }
+        if (__builtin_cpu_supports("sse4.2")) { return Isa::Sse42; }
+        return Isa::Scalar;
+    }();
+    return isa;
+}
+
+struct BlockMasks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op; // { } [ ] : ,
+    uint64_t whitespace;
+};
+
+inline bool isWhitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+inline bool isOp(char c) {
+    // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+    char lower = c | 0x20;
+    return c == ',' || c == ':' || lower == '{' || lower == '}';
+}
+
+inline BlockMasks classifyScalar(const char *block) {
+    BlockMasks m{0, 0, 0, 0};
+    for (int i = 0; i < 64; i++) {
+        uint64_t bit = uint64_t(1) << i;
+        char c = block[i];
+        if (c == '"') { m.quote |= bit; }
+        if (c == '\\') { m.backslash |= bit; }
+        if (isOp(c)) { m.op |= bit; }
+        if (isWhitespace(c)) { m.whitespace |= bit; }
+    }
+    return m;
+}
+
+__attribute__((target("sse4.2")))
+inline BlockMasks classifySse42(const char *block) {
+    const __m128i ops = _mm_setr_epi8('{', '}', '[', ']', ':', ',', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i spaces = _mm_setr_epi8(' ', '\t', '\n', '\r', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    constexpr int ANY = _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK;
+    BlockMasks m{0, 0, 0, 0};
+    for (int i = 0; i < 4; i++) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+        int shift = 16 * i;
+        m.quote |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote)))) << shift;
+        m.backslash |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash)))) << shift;
+        // explicit lengths, a NUL byte in the input must not end the compare
+        m.op |= uint64_t(uint16_t(_mm_cvtsi128_si32(_mm_cmpestrm(ops, 6, chunk, 16, ANY)))) << shift;
+        m.whitespace |= uint64_t(uint16_t(_mm_cvtsi128_si32(_mm_cmpestrm(spaces, 4, chunk, 16, ANY)))) << shift;
+    }
+    return m;
+}
+
+__attribute__((target("avx2")))
+inline __m256i eq(__m256i v, char c) {
+    return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+}
+
+__attribute__((target("avx2")))
+inline BlockMasks classifyAvx2(const char *block) {
+    BlockMasks m{0, 0, 0, 0};
+    for (int i = 0; i < 2; i++) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * i));
+        __m256i lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+        __m256i op = _mm256_or_si256(
+            _mm256_or_si256(eq(chunk, ','), eq(chunk, ':')),
+            _mm256_or_si256(eq(lower, '{'), eq(lower, '}')));
+        __m256i ws = _mm256_or_si256(
+            _mm256_or_si256(eq(chunk, ' '), eq(chunk, '\n')),
+            _mm256_or_si256(eq(chunk, '\r'), eq(chunk, '\t')));
+        int shift = 32 * i;
+        m.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(eq(chunk, '"')))) << shift;
+        m.backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(eq(chunk, '\\')))) << shift;
+        m.op |= uint64_t(uint32_t(_mm256_movemask_epi8(op))) << shift;
+        m.whitespace |= uint64_t(uint32_t(_mm256_movemask_epi8(ws))) << shift;
+    }
+    return m;
+}
+
+// bit i of the result is the xor of bits 0..i
+inline uint64_t prefixXor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// finds string interiors block by block, carrying open escapes and strings
+// from one block to the next
+class StringScanner {
+private:
+    uint64_t prevOddBackslash = 0; // last block ended in an odd backslash run
+    uint64_t prevInString = 0;     // all ones if the last block ended in a string
+
+    // bits of characters escaped by an odd length backslash run
+    uint64_t escaped(uint64_t backslash) {
+        const uint64_t even = 0x5555555555555555ULL;
+        uint64_t startEdges = backslash & ~(backslash << 1);
+        uint64_t evenStartMask = even ^ prevOddBackslash;
+        uint64_t evenStarts = startEdges & evenStartMask;
+        uint64_t oddStarts = startEdges & ~evenStartMask;
+        uint64_t evenCarries = backslash + evenStarts;
+        uint64_t oddCarries;
+        bool endsOdd = __builtin_add_overflow(backslash, oddStarts, &oddCarries);
+        oddCarries |= prevOddBackslash;
+        prevOddBackslash = endsOdd ? 1 : 0;
+        uint64_t evenStartOddEnd = evenCarries & ~backslash & ~even;
+        uint64_t oddStartEvenEnd = oddCarries & ~backslash & even;
+        return evenStartOddEnd | oddStartEvenEnd;
+    }
+
+public:
+    // set from an opening quote up to, not including, its closing quote.
+    // quotes receives the unescaped quotes
+    uint64_t strings(uint64_t quote, uint64_t backslash, uint64_t& quotes) {
+        quotes = quote & ~escaped(backslash);
+        uint64_t inString = prefixXor(quotes) ^ prevInString;
+        prevInString = uint64_t(int64_t(inString) >> 63);
+        return inString;
+    }
+    bool inString() const { return prevInString != 0; }
+};
+
+// turns block masks into index entries, carrying state across blocks
+class StructuralIndexer {
+private:
+    StringScanner scanner;
+    uint64_t prevScalar = 0; // last byte of the last block was a scalar
+
+public:
+    // appends the structural offsets of the block starting at base to out
+    uint32_t* add(const BlockMasks& m, uint32_t base, uint32_t* out) {
+        uint64_t quotes;
+        uint64_t inString = scanner.strings(m.quote, m.backslash, quotes);
+        uint64_t openQuotes = quotes & inString;
+        uint64_t scalar = ~(m.op | m.whitespace | quotes) & ~inString;
+        uint64_t scalarStarts = scalar & ~((scalar << 1) | prevScalar);
+        prevScalar = scalar >> 63;
+        uint64_t bits = openQuotes | (m.op & ~inString) | scalarStarts;
+        // unconditional stores in groups of eight keep the loop free of
+        // mispredicted branches, out needs 64 entries of slack
+        int count = __builtin_popcountll(bits);
+        for (int i = 0; i < count; i += 8) {
+            for (int k = 0; k < 8; k++) {
+                out[i + k] = base + __builtin_ctzll(bits | (uint64_t(1) << 63));
+                bits &= bits - 1;
+            }
+        }
+        return out + count;
+    }
+    bool inString() const { return scanner.inString(); }
+};
+
+template <BlockMasks (*Classify)(const char*)>
+__attribute__((always_inline)) inline uint32_t* indexBlocks(const char* data, size_t n, uint32_t* out, StructuralIndexer& indexer) {
+    size_t full = n / 64 * 64;
+    for (size_t i = 0; i < full; i += 64) {
+        out = indexer.add(Classify(data + i), uint32_t(i), out);
+    }
+    if (full < n) {
+        // pad the last partial block with whitespace
+        char block[64];
+        std::memset(block, ' ', sizeof(block));
+        std::memcpy(block, data + full, n - full);
+        out = indexer.add(Classify(block), uint32_t(full), out);
+    }
+    return out;
+}
+
+// each target gets its own copy of the loop so the classifier inlines
+__attribute__((target("avx2")))
+inline uint32_t* indexAvx2(const char* data, size_t n, uint32_t* out, StructuralIndexer& indexer) {
+    return indexBlocks<classifyAvx2>(data, n, out, indexer);
+}
+
+__attribute__((target("sse4.2")))
+inline uint32_t* indexSse42(const char* data, size_t n, uint32_t* out, StructuralIndexer& indexer) {
+    return indexBlocks<classifySse42>(data, n, out, indexer);
+}
+
+inline uint32_t* indexScalar(const char* data, size_t n, uint32_t* out, StructuralIndexer& indexer) {
+    return indexBlocks<classifyScalar>(data, n, out, indexer);
+}
+
+// offsets of all structural characters, terminated by the input length.
+// the buffer is kept between build() calls and never zero filled.
+class StructuralIndex {
+private:
+    std::unique_ptr<uint32_t[]> positions;
+    size_t capacity = 0;
+    size_t count = 0;
+
+public:
+    void build(const char* data, size_t n, Isa isa = detectIsa()) {
+        if (n >= UINT32_MAX) {
+            throw std::runtime_error("Document too large for a 32 bit index");
+        }
+        // at most one entry per byte, the terminator and the flush slack
+        if (capacity < n + 65) {
+            capacity = n + 65;
+            positions.reset(new uint32_t[capacity]);
+        }
+        StructuralIndexer indexer;
+        uint32_t* out = positions.get();
+        switch (isa) {
+            case Isa::Avx2: { out = indexAvx2(data, n, out, indexer); break; }
+            case Isa::Sse42: { out = indexSse42(data, n, out, indexer); break; }
+            case Isa::Scalar: { out = indexScalar(data, n, out, indexer); break; }
+        }
+        if (indexer.inString()) {
+            throw std::runtime_error("Unterminated string literal");
+        }
+        *out++ = uint32_t(n);
+        count = out - positions.get();
+    }
+    size_t size() const { return count; }
+    uint32_t operator[](size_t i) const { return positions[i]; }
+    const uint32_t* begin() const { return positions.get(); }
+    const uint32_t* end() const { return positions.get() + count; }
+};
+
+// scalar helpers shared by the stage 2 builders, they rely on stage 1
+// having checked that every string is closed
+
+// a scalar must be followed by whitespace, a structural character or the end
+inline void expectDelimiter(const char* p, const char* end) {
+    if (p < end && !isWhitespace(*p) && !isOp(*p)) {
+        throw std::runtime_error("Unexpected character");
+    }
+}
+
+inline void expectLiteral(const char* p, const char* end, const char* literal) {
+    size_t n = std::strlen(literal);
+    if (size_t(end - p) < n || std::memcmp(p, literal, n) != 0) {
+        throw std::runtime_error("Cannot parse literal");
+    }
+    expectDelimiter(p + n, end);
+}
+
+// returns the end of the number, integers that fit stay exact
+inline const char* parseNumber(const char* first, const char* end, jsonnum::Number& value) {
+    const char* last = jsonnum::parse(first, end, value);
+    if (last == nullptr) {
+        throw std::runtime_error("Cannot parse number");
+    }
+    expectDelimiter(last, end);
+    return last;
+}
+
+inline const char* parseNumber(const char* first, const char* end, double& value) {
+    jsonnum::Number number;
+    const char* last = parseNumber(first, end, number);
+    value = number.toDouble();
+    return last;
+}
+
+} // namespace jsonsimd
+
+// stage 2: builds the same JsonValue tree as Json from the structural index
+class SimdJson {
+private:
+    std::string data;
+    jsonsimd::StructuralIndex index;
+    size_t cur;
+
+    uint32_t next() { return index[cur++]; }
+    char peekChar() const { return data[index[cur]]; }
+
+    JsonValue parseValue() {
+        uint32_t pos = next();
+        if (pos >= data.size()) {
+            throw std::runtime_error("Unexpected end of input");
+        }
+        switch (data[pos]) {
+            case 'n': { return parseLiteral(pos, "null", {nullptr}); }
+            case 't': { return parseLiteral(pos, "true", {true}); }
+            case 'f': { return parseLiteral(pos, "false", {false}); }
+            case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9': { return parseNumber(pos); }
+            case '"': { return {parseString(pos)}; }
+            case '[': { return parseArray(); }
+            case '{': { return parseObject(); }
+            default: {
+                throw std::runtime_error("Unexpected character");
+            }
+        }
+    }
+
+    JsonValue parseLiteral(size_t pos, const char* literal, JsonValue value) {
+        jsonsimd::expectLiteral(data.data() + pos, data.data() + data.size(), literal);
+        return value;
+    }
+
+    JsonValue parseNumber(size_t pos) {
+        jsonnum::Number value;
+        jsonsimd::parseNumber(data.data() + pos, data.data() + data.size(), value);
+        return JsonValue::fromNumber(value);
+    }
+
+    std::string parseString(size_t pos) {
+        std::string result;
+        jsonstr::decode(data.data() + pos + 1, data.data() + data.size(), result);
+        return result;
+    }
+
+    JsonValue parseArray() {
+        JsonArray arr;
+        if (peekChar() == ']') {
+            cur++;
+            return {std::move(arr)};
+        }
+        while (true) {
+            arr.push_back(parseValue());
+            char c = data[next()];
+            if (c == ']') {
+                break;
+            } else if (c != ',') {
+                throw std::runtime_error("Expected ',' or ']'");
+            }
+        }
+        return {std::move(arr)};
+    }
+
+    JsonValue parseObject() {
+        JsonObject obj;
+        if (peekChar() == '}') {
+            cur++;
+            return {std::move(obj)};
+        }
+        while (true) {
+            uint32_t pos = next();
+            if (data[pos] != '"') { throw std::runtime_error("Expected string key"); }
+            std::string key = parseString(pos);
+            if (data[next()] != ':') { throw std::runtime_error("Expected ':'"); }
+            obj[std::move(key)] = parseValue();
+            char c = data[next()];
+            if (c == '}') {
+                break;
+            } else if (c != ',') {
+                throw std::runtime_error("Expected ',' or '}'");
+            }
+        }
+        return {std::move(obj)};
+    }
+
+public:
+    JsonValue parse(std::string text, jsonsimd::Isa isa = jsonsimd::detectIsa()) {
+        data = std::move(text);
+        index.build(data.data(), data.size(), isa);
+        cur = 0;
+        JsonValue res = parseValue();
+        if (index[cur] != data.size()) {
+            throw std::runtime_error("Unexpected trailing characters");
+        }
+        return res;
+    }
+
+    JsonValue parseFromFile(std::string path) {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Unable to open file");
+        }
+        std::string text(
+            (std::istreambuf_iterator<char>(file)),
+            std::istreambuf_iterator<char>()
+        );
+        return parse(std::move(text));
+    }
+};
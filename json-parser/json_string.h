@@ -0,0 +1,397 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+#include <stdexcept>
+#include <string>
+
+// string bodies: scanning, UTF-8 validation, unescaping and escaping
+//
+// scan() finds the quote or backslash that ends a run of plain bytes and
+// validates the UTF-8 of the run on the way. with AVX2 it takes 32 bytes at
+// a time: ASCII chunks cost two compares and a movemask, chunks with
+// multibyte characters go through the nibble lookup validator of Keiser and
+// Lemire ("Validating UTF-8 in less than one instruction per byte"). every
+// chunk is validated from a character boundary, a sequence cut off at its
+// end is left for the next chunk, so no state is carried between chunks.
+// the last bytes before the quote and inputs without AVX2 are validated one
+// code point at a time.
+//
+// decode() appends a string body to a std::string, copying plain runs in
+// one append and turning \uXXXX escapes, surrogate pairs included, into
+// UTF-8. escapeRun() is the writer's counterpart, the length of the prefix
+// that needs no escaping.
+
+namespace jsonstr {
+
+inline bool hasAvx2() {
+    static const bool avx2 = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return avx2;
+}
+
+// appends code point cp to out as UTF-8
+inline void appendUtf8(uint32_t cp, std::string& out) {
+    char buf[4];
+    size_t n;
+    if (cp < 0x80) {
+        buf[0] = char(cp);
+        n = 1;
+    } else if (cp < 0x800) {
+        buf[0] = char(0xc0 | (cp >> 6));
+        buf[1] = char(0x80 | (cp & 0x3f));
+        n = 2;
+    } else if (cp < 0x10000) {
+        buf[0] = char(0xe0 | (cp >> 12));
+        buf[1] = char(0x80 | ((cp >> 6) & 0x3f));
+        buf[2] = char(0x80 | (cp & 0x3f));
+        n = 3;
+    } else {
+        buf[0] = char(0xf0 | (cp >> 18));
+        buf[1] = char(0x80 | ((cp >> 12) & 0x3f));
+        buf[2] = char(0x80 | ((cp >> 6) & 0x3f));
+        buf[3] = char(0x80 | (cp & 0x3f));
+        n = 4;
+    }
+    out.append(buf, n);
+}
+
+// length of the well formed UTF-8 sequence at p (p < end, *p >= 0x80),
+// 0 if it is not one. second bytes are range checked per lead byte, which
+// rules out overlong forms, surrogates and code points above U+10FFFF
+inline size_t sequenceLength(const unsigned char* p, const unsigned char* end) {
+    unsigned char c = p[0];
+    size_t n;
+    unsigned char lo = 0x80, hi = 0xbf;
+    if (c >= 0xc2 && c <= 0xdf) {
+        n = 2;
+    } else if (c >= 0xe0 && c <= 0xef) {
+        n = 3;
+        if (c == 0xe0) lo = 0xa0;
+        if (c == 0xed) hi = 0x9f;
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        n = 4;
+        if (c == 0xf0) lo = 0x90;
+        if (c == 0xf4) hi = 0x8f;
+    } else {
+        return 0;
+    }
+    if (size_t(end - p) < n || p[1] < lo || p[1] > hi) {
+        return 0;
+    }
+    for (size_t i = 2; i < n; i++) {
+        if ((p[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+    }
+    return n;
+}
+
+inline void validateScalar(const char* p, const char* end) {
+    const unsigned char* q = reinterpret_cast<const unsigned char*>(p);
+    const unsigned char* e = reinterpret_cast<const unsigned char*>(end);
+    while (q < e) {
+        if (*q < 0x80) {
+            q++;
+            continue;
+        }
+        size_t n = sequenceLength(q, e);
+        if (n == 0) {
+            throw std::runtime_error("Invalid UTF-8 in string");
+        }
+        q += n;
+    }
+}
+
+inline const char* scanScalar(const char* p, const char* end) {
+    const unsigned char* q = reinterpret_cast<const unsigned char*>(p);
+    const unsigned char* e = reinterpret_cast<const unsigned char*>(end);
+    while (q < e) {
+        unsigned char c = *q;
+        if (c == '"' || c == '\\') {
+            return reinterpret_cast<const char*>(q);
+        }
+        if (c < 0x80) {
+            q++;
+            continue;
+        }
+        size_t n = sequenceLength(q, e);
+        if (n == 0) {
+            throw std::runtime_error("Invalid UTF-8 in string");
+        }
+        q += n;
+    }
+    throw std::runtime_error("Unterminated string literal");
+}
+
+// error bits of the lookup validator, a byte pair is invalid when the
+// three tables agree on one of them
+constexpr uint8_t TOO_SHORT = 1 << 0;  // lead not followed by a continuation
+constexpr uint8_t TOO_LONG = 1 << 1;   // ASCII followed by a continuation
+constexpr uint8_t OVERLONG_3 = 1 << 2; // E0 80..9F
+constexpr uint8_t TOO_LARGE = 1 << 3;  // F4 90..BF, F5..FF
+constexpr uint8_t SURROGATE = 1 << 4;  // ED A0..BF
+constexpr uint8_t OVERLONG_2 = 1 << 5; // C0, C1
+constexpr uint8_t TOO_LARGE_1000 = 1 << 6;
+constexpr uint8_t OVERLONG_4 = 1 << 6; // F0 80..8F
+constexpr uint8_t TWO_CONTS = 1 << 7;  // continuation after continuation
+constexpr uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+__attribute__((target("avx2")))
+inline __m256i table(uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3, uint8_t a4, uint8_t a5,
+                     uint8_t a6, uint8_t a7, uint8_t a8, uint8_t a9, uint8_t a10, uint8_t a11,
+                     uint8_t a12, uint8_t a13, uint8_t a14, uint8_t a15) {
+    return _mm256_setr_epi8(a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15,
+                            a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15);
+}
+
+__attribute__((target("avx2")))
+inline __m256i highNibble(__m256i v) {
+    return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0f));
+}
+
+// v shifted right by n bytes across the lane boundary, zeros shifted in,
+// the chunk is validated as if it followed ASCII
+template <int N>
+__attribute__((target("avx2")))
+inline __m256i previous(__m256i v) {
+    __m256i low = _mm256_permute2x128_si256(v, v, 0x08); // [0, v.lo]
+    return _mm256_alignr_epi8(v, low, 16 - N);
+}
+
+// true if the 32 bytes starting at a character boundary hold no invalid
+// sequence, sequences running past the end are not checked
+__attribute__((target("avx2")))
+inline bool validAvx2(__m256i input) {
+    __m256i prev1 = previous<1>(input);
+    __m256i byte1High = _mm256_shuffle_epi8(
+        table(TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+              TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+              TOO_SHORT | OVERLONG_2,
+              TOO_SHORT,
+              TOO_SHORT | OVERLONG_3 | SURROGATE,
+              TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4),
+        highNibble(prev1));
+    __m256i byte1Low = _mm256_shuffle_epi8(
+        table(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+              CARRY | OVERLONG_2,
+              CARRY,
+              CARRY,
+              CARRY | TOO_LARGE,
+              CARRY | TOO_LARGE | TOO_LARGE_1000,
+              CARRY | TOO_LARGE | TOO_LARGE_1000,
+              CARRY | TOO_LARGE | TOO_LARGE_1000,
+              CARRY | TOO_LARGE | TOO_LARGE_1000,
+              CARRY | TOO_LARGE | TOO_LARGE_1000,
+              CARRY | TOO_LARGE | TOO_LARGE_1000,
+              CARRY | TOO_LARGE | TOO_LARGE_1000,
+              CARRY | TOO_LARGE | TOO_LARGE_1000,
+              CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+              CARRY | TOO_LARGE | TOO_LARGE_1000,
+              CARRY | TOO_LARGE | TOO_LARGE_1000),
+        _mm256_and_si256(prev1, _mm256_set1_epi8(0x0f)));
+    __m256i byte2High = _mm256_shuffle_epi8(
+        table(TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+              TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+              TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+              TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+              TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+              TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT),
+        highNibble(input));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+    // third and fourth bytes of 3 and 4 byte sequences must be
+    // continuations, the only place TWO_CONTS is expected
+    __m256i third = _mm256_subs_epu8(previous<2>(input), _mm256_set1_epi8(char(0xe0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(previous<3>(input), _mm256_set1_epi8(char(0xf0 - 0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(char(0x80)));
+    return _mm256_testz_si256(_mm256_xor_si256(must23, special), _mm256_xor_si256(must23, special));
+}
+
+// bytes at the end of a chunk that start a sequence it does not finish
+inline size_t cutOff(const unsigned char* chunk) {
+    if (chunk[31] >= 0xc0) return 1;
+    if (chunk[30] >= 0xe0) return 2;
+    if (chunk[29] >= 0xf0) return 3;
+    return 0;
+}
+
+__attribute__((target("avx2")))
+inline const char* scanAvx2(const char* p, const char* end) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint32_t stop = uint32_t(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash))));
+        uint32_t high = uint32_t(_mm256_movemask_epi8(v));
+        if (stop != 0) {
+            int k = __builtin_ctz(stop);
+            if ((high & ((uint32_t(1) << k) - 1)) != 0) {
+                validateScalar(p, p + k);
+            }
+            return p + k;
+        }
+        if (high == 0) {
+            p += 32;
+            continue;
+        }
+        if (!validAvx2(v)) {
+            throw std::runtime_error("Invalid UTF-8 in string");
+        }
+        p += 32 - cutOff(reinterpret_cast<const unsigned char*>(p));
+    }
+    return scanScalar(p, end);
+}
+
+// first quote or backslash at or after p, the bytes before it are valid
+// UTF-8. throws if there is neither before end
+inline const char* scan(const char* p, const char* end) {
+    return hasAvx2() ? scanAvx2(p, end) : scanScalar(p, end);
+}
+
+__attribute__((target("avx2")))
+inline void validateAvx2(const char* p, const char* end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        if (_mm256_movemask_epi8(v) == 0) {
+            p += 32;
+            continue;
+        }
+        if (!validAvx2(v)) {
+            throw std::runtime_error("Invalid UTF-8 in string");
+        }
+        p += 32 - cutOff(reinterpret_cast<const unsigned char*>(p));
+    }
+    validateScalar(p, end);
+}
+
+// throws unless [p, end) is valid UTF-8, for raw string bytes that were
+// already split at quotes and backslashes
+inline void validate(const char* p, const char* end) {
+    if (hasAvx2()) {
+        validateAvx2(p, end);
+    } else {
+        validateScalar(p, end);
+    }
+}
+
+// bytes at the end of [p, end) that start a sequence running past end,
+// a streaming caller keeps them for the next chunk
+inline size_t incompleteTail(const char* p, const char* end) {
+    for (size_t k = 1; k <= 3 && k <= size_t(end - p); k++) {
+        unsigned char c = static_cast<unsigned char>(end[-ptrdiff_t(k)]);
+        if (c < 0x80) {
+            return 0;
+        }
+        if (c >= 0xc0) {
+            size_t n = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : 2;
+            return n > k ? k : 0;
+        }
+    }
+    return 0;
+}
+
+inline int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+inline uint32_t hex4(const char* p, const char* end) {
+    if (end - p < 4) {
+        throw std::runtime_error("Invalid \\u escape");
+    }
+    uint32_t v = 0;
+    for (int k = 0; k < 4; k++) {
+        int d = hexValue(p[k]);
+        if (d < 0) {
+            throw std::runtime_error("Invalid \\u escape");
+        }
+        v = v << 4 | d;
+    }
+    return v;
+}
+
+// p is on a backslash, appends the escaped character and returns the
+// position after the escape
+inline const char* unescape(const char* p, const char* end, std::string& out) {
+    p++;
+    if (p == end) {
+        throw std::runtime_error("Invalid escape sequence");
+    }
+    switch (*p++) {
+        case '"': out += '"'; break;
+        case '\\': out += '\\'; break;
+        case '/': out += '/'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u': {
+            uint32_t cp = hex4(p, end);
+            p += 4;
+            if (cp >= 0xd800 && cp <= 0xdbff) {
+                if (end - p < 2 || p[0] != '\\' || p[1] != 'u') {
+                    throw std::runtime_error("Invalid surrogate pair");
+                }
+                uint32_t low = hex4(p + 2, end);
+                if (low < 0xdc00 || low > 0xdfff) {
+                    throw std::runtime_error("Invalid surrogate pair");
+                }
+                p += 6;
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            } else if (cp >= 0xdc00 && cp <= 0xdfff) {
+                throw std::runtime_error("Invalid surrogate pair");
+            }
+            appendUtf8(cp, out);
+            break;
+        }
+        default: throw std::runtime_error("Invalid escape sequence");
+    }
+    return p;
+}
+
+// appends the string starting after the opening quote at p to out and
+// returns the position after the closing quote
+inline const char* decode(const char* p, const char* end, std::string& out) {
+    while (true) {
+        const char* q = scan(p, end);
+        out.append(p, q - p);
+        if (*q == '"') {
+            return q + 1;
+        }
+        p = unescape(q, end, out);
+    }
+}
+
+__attribute__((target("avx2")))
+inline size_t escapeRunAvx2(const char* p, size_t n) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1f);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        // unsigned v <= 0x1f
+        __m256i low = _mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control);
+        uint32_t stop = uint32_t(_mm256_movemask_epi8(_mm256_or_si256(
+            low, _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)))));
+        if (stop != 0) {
+            return i + __builtin_ctz(stop);
+        }
+    }
+    return i;
+}
+
+// length of the prefix of p[0, n) without quotes, backslashes and control
+// characters, possibly short of the first one by less than 32 bytes
+inline size_t escapeRun(const char* p, size_t n) {
+    return hasAvx2() ? escapeRunAvx2(p, n) : 0;
+}
+
+} // namespace jsonstr
@@ -0,0 +1,488 @@
+#pragma once
+
+#include "json.h"
+#include "json_mmap.h"
+#include "json_simd.h"
+#include "json_string.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// flat read-only document: one tape of tagged 64 bit words plus one string
+// buffer instead of a JsonValue per node
+//
+// every word is [8 bit tag][56 bit payload]:
+//   'r'            root, payload is the index of the closing root word
+//   'n' 't' 'f'    null, true, false
+//   'd' 'l' 'u'    double, int64, uint64, the raw bits follow in the next
+//                  word. integers that fit are kept exact
+//   '"'            string, payload is the offset of [u32 length][bytes]
+//                  in the string buffer
+//   's'            string without escapes inside a mapped input file,
+//                  payload is [24 bit length][32 bit offset into the file]
+//   '[' '{'        payload is the index after the matching close word, bits
+//                  32..55 of it hold the element count (saturated)
+//   ']' '}'        payload is the index of the matching open word
+// object members are key string followed by the value. loading a document is
+// a couple of vector allocations and freeing it is two frees. documents read
+// with parseFromFile keep the file mapped and only copy strings that contain
+// escapes.
+
+class JsonDocument;
+
+namespace jsontape {
+
+constexpr uint64_t PAYLOAD_MASK = (uint64_t(1) << 56) - 1;
+constexpr uint64_t COUNT_MAX = 0xffffff;
+constexpr uint64_t VIEW_LENGTH_MAX = 0xffffff;
+
+inline uint64_t word(char tag, uint64_t payload) {
+    return (uint64_t(static_cast<unsigned char>(tag)) << 56) | payload;
+}
+inline char tagOf(uint64_t w) { return static_cast<char>(w >> 56); }
+inline uint64_t payloadOf(uint64_t w) { return w & PAYLOAD_MASK; }
+
+} // namespace jsontape
+
+class JsonArrayView;
+class JsonObjectView;
+
+// one value inside a document, a document pointer plus a tape index
+class JsonElement {
+private:
+    const JsonDocument* doc;
+    size_t i;
+
+    char tag() const;
+    uint64_t rawBits() const;
+
+public:
+    JsonElement(const JsonDocument* doc, size_t i) : doc(doc), i(i) {}
+
+    bool isNull() const { return tag() == 'n'; }
+    bool isBool() const { return tag() == 't' || tag() == 'f'; }
+    bool isNumber() const { return tag() == 'd' || tag() == 'l' || tag() == 'u'; }
+    // integer that was written without fraction or exponent and fits
+    bool isInt64() const { return tag() == 'l'; }
+    bool isUint64() const { return tag() == 'u' || (tag() == 'l' && rawBits() >> 63 == 0); }
+    bool isString() const { return tag() == '"' || tag() == 's'; }
+    bool isArray() const { return tag() == '['; }
+    bool isObject() const { return tag() == '{'; }
+    bool getBool() const;
+    // any number, integers beyond 2^53 are rounded
+    double getNumber() const;
+    int64_t getInt64() const;
+    uint64_t getUint64() const;
+    std::string_view getString() const;
+    JsonArrayView getArray() const;
+    JsonObjectView getObject() const;
+    // member lookup, throws unless this is an object with the key
+    JsonElement operator[](std::string_view key) const;
+    // copies the subtree into the JsonValue tree Json works with
+    JsonValue toValue() const;
+    // tape index just past this element
+    size_t after() const;
+    size_t index() const { return i; }
+};
+
+class JsonArrayView {
+private:
+    const JsonDocument* doc;
+    size_t open;
+
+public:
+    class iterator {
+    private:
+        const JsonDocument* doc;
+        size_t i;
+
+    public:
+        iterator(const JsonDocument* doc, size_t i) : doc(doc), i(i) {}
+        JsonElement operator*() const { return {doc, i}; }
+        iterator& operator++() { i = JsonElement(doc, i).after(); return *this; }
+        bool operator!=(const iterator& other) const { return i != other.i; }
+        bool operator==(const iterator& other) const { return i == other.i; }
+    };
+
+    JsonArrayView(const JsonDocument* doc, size_t open) : doc(doc), open(open) {}
+    iterator begin() const;
+    iterator end() const;
+    size_t size() const;
+    // linear, arrays have no random access on the tape
+    JsonElement at(size_t n) const;
+};
+
+class JsonObjectView {
+private:
+    const JsonDocument* doc;
+    size_t open;
+
+public:
+    struct Member {
+        std::string_view key;
+        JsonElement value;
+    };
+
+    class iterator {
+    private:
+        const JsonDocument* doc;
+        size_t i; // index of the key
+
+    public:
+        iterator(const JsonDocument* doc, size_t i) : doc(doc), i(i) {}
+        Member operator*() const {
+            return {JsonElement(doc, i).getString(), JsonElement(doc, i + 1)};
+        }
+        iterator& operator++() { i = JsonElement(doc, i + 1).after(); return *this; }
+        bool operator!=(const iterator& other) const { return i != other.i; }
+        bool operator==(const iterator& other) const { return i == other.i; }
+    };
+
+    JsonObjectView(const JsonDocument* doc, size_t open) : doc(doc), open(open) {}
+    iterator begin() const;
+    iterator end() const;
+    size_t size() const;
+    bool contains(std::string_view key) const { return find(key) != end(); }
+    // linear scan over the keys, first match wins
+    iterator find(std::string_view key) const;
+    JsonElement at(std::string_view key) const;
+    JsonElement operator[](std::string_view key) const { return at(key); }
+};
+
+class JsonDocument {
+private:
+    friend class JsonElement;
+    friend class JsonArrayView;
+    friend class JsonObjectView;
+
+    std::vector<uint64_t> tape;
+    std::string strings;
+    std::shared_ptr<const MappedFile> source; // set by parseFromFile
+
+    // stage 2 over the structural index, writes straight to the tape
+    class Builder {
+    private:
+        JsonDocument& doc;
+        const char* data;
+        const char* end;
+        const jsonsimd::StructuralIndex& index;
+        size_t cur = 0;
+
+        // the last index entry is the input size, text may be a view with
+        // no terminator after it, so that entry is never dereferenced
+        uint32_t peek() const {
+            uint32_t pos = index[cur];
+            if (data + pos >= end) {
+                throw std::runtime_error("Unexpected end of input");
+            }
+            return pos;
+        }
+        uint32_t next() {
+            uint32_t pos = peek();
+            cur++;
+            return pos;
+        }
+        char peekChar() const { return data[peek()]; }
+
+        void parseString(size_t pos) {
+            const char* start = data + pos + 1;
+            const char* p = start;
+            if (doc.source) {
+                p = jsonstr::scan(start, end);
+                uint64_t length = p - start;
+                if (*p == '"' && length <= jsontape::VIEW_LENGTH_MAX) {
+                    doc.tape.push_back(jsontape::word('s', (pos + 1) | (length << 32)));
+                    return;
+                }
+            }
+            std::string& strings = doc.strings;
+            size_t offset = strings.size();
+            doc.tape.push_back(jsontape::word('"', offset));
+            strings.append(sizeof(uint32_t), '\0');
+            strings.append(start, p - start);
+            jsonstr::decode(p, end, strings);
+            uint32_t length = uint32_t(strings.size() - offset - sizeof(uint32_t));
+            std::memcpy(&strings[offset], &length, sizeof(length));
+        }
+
+        // container words are patched once the matching close is known
+        void close(size_t open, char openTag, char closeTag, uint64_t count) {
+            std::vector<uint64_t>& tape = doc.tape;
+            tape.push_back(jsontape::word(closeTag, open));
+            uint64_t after = tape.size();
+            tape[open] = jsontape::word(openTag, after | (std::min(count, jsontape::COUNT_MAX) << 32));
+        }
+
+        void parseValue() {
+            uint32_t pos = next();
+            std::vector<uint64_t>& tape = doc.tape;
+            switch (data[pos]) {
+                case 'n': { jsonsimd::expectLiteral(data + pos, end, "null"); tape.push_back(jsontape::word('n', 0)); break; }
+                case 't': { jsonsimd::expectLiteral(data + pos, end, "true"); tape.push_back(jsontape::word('t', 0)); break; }
+                case 'f': { jsonsimd::expectLiteral(data + pos, end, "false"); tape.push_back(jsontape::word('f', 0)); break; }
+                case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9': {
+                    jsonnum::Number value;
+                    jsonsimd::parseNumber(data + pos, end, value);
+                    uint64_t bits;
+                    std::memcpy(&bits, &value.d, sizeof(bits)); // same bits for i and u
+                    char numberTag = value.type == jsonnum::NumberType::Int64 ? 'l' :
+                                     value.type == jsonnum::NumberType::Uint64 ? 'u' : 'd';
+                    tape.push_back(jsontape::word(numberTag, 0));
+                    tape.push_back(bits);
+                    break;
+                }
+                case '"': { parseString(pos); break; }
+                case '[': { parseArray(); break; }
+                case '{': { parseObject(); break; }
+                default: {
+                    throw std::runtime_error("Unexpected character");
+                }
+            }
+        }
+
+        void parseArray() {
+            size_t open = doc.tape.size();
+            doc.tape.push_back(0);
+            uint64_t count = 0;
+            if (peekChar() == ']') {
+                cur++;
+                close(open, '[', ']', count);
+                return;
+            }
+            while (true) {
+                parseValue();
+                count++;
+                char c = data[next()];
+                if (c == ']') {
+                    break;
+                } else if (c != ',') {
+                    throw std::runtime_error("Expected ',' or ']'");
+                }
+            }
+            close(open, '[', ']', count);
+        }
+
+        void parseObject() {
+            size_t open = doc.tape.size();
+            doc.tape.push_back(0);
+            uint64_t count = 0;
+            if (peekChar() == '}') {
+                cur++;
+                close(open, '{', '}', count);
+                return;
+            }
+            while (true) {
+                uint32_t pos = next();
+                if (data[pos] != '"') { throw std::runtime_error("Expected string key"); }
+                parseString(pos);
+                if (data[next()] != ':') { throw std::runtime_error("Expected ':'"); }
+                parseValue();
+                count++;
+                char c = data[next()];
+                if (c == '}') {
+                    break;
+                } else if (c != ',') {
+                    throw std::runtime_error("Expected ',' or '}'");
+                }
+            }
+            close(open, '{', '}', count);
+        }
+
+    public:
+        Builder(JsonDocument& doc, const char* data, size_t n, const jsonsimd::StructuralIndex& index)
+            : doc(doc), data(data), end(data + n), index(index) {}
+
+        void build() {
+            // one word per index entry covers everything but numbers
+            doc.tape.reserve(index.size() + 2);
+            if (!doc.source) {
+                // unescaped strings are never longer than the input
+                doc.strings.reserve(end - data);
+            }
+            doc.tape.push_back(0);
+            parseValue();
+            if (data + index[cur] != end) {
+                throw std::runtime_error("Unexpected trailing characters");
+            }
+            doc.tape.push_back(jsontape::word('r', 0));
+            doc.tape[0] = jsontape::word('r', doc.tape.size() - 1);
+        }
+    };
+
+public:
+    // text must stay alive during the call only, nothing points into it
+    static JsonDocument parse(std::string_view text, jsonsimd::Isa isa = jsonsimd::detectIsa()) {
+        jsonsimd::StructuralIndex index;
+        return parse(text, index, isa);
+    }
+    // reuses the index buffer across documents
+    static JsonDocument parse(std::string_view text, jsonsimd::StructuralIndex& index,
+                              jsonsimd::Isa isa = jsonsimd::detectIsa()) {
+        JsonDocument doc;
+        index.build(text.data(), text.size(), isa);
+        Builder(doc, text.data(), text.size(), index).build();
+        return doc;
+    }
+    // maps the file and keeps it mapped for the lifetime of the document,
+    // strings without escapes point into the mapping
+    static JsonDocument parseFromFile(std::string path, jsonsimd::Isa isa = jsonsimd::detectIsa()) {
+        JsonDocument doc;
+        doc.source = std::make_shared<const MappedFile>(path);
+        jsonsimd::StructuralIndex index;
+        index.build(doc.source->data(), doc.source->size(), isa);
+        Builder(doc, doc.source->data(), doc.source->size(), index).build();
+        return doc;
+    }
+
+    JsonElement root() const { return {this, 1}; }
+    size_t tapeSize() const { return tape.size(); }
+    size_t stringBytes() const { return strings.size(); }
+};
+
+inline char JsonElement::tag() const { return jsontape::tagOf(doc->tape[i]); }
+
+inline bool JsonElement::getBool() const {
+    if (!isBool()) throw std::runtime_error("Type is not bool");
+    return tag() == 't';
+}
+
+inline uint64_t JsonElement::rawBits() const { return doc->tape[i + 1]; }
+
+inline double JsonElement::getNumber() const {
+    if (!isNumber()) throw std::runtime_error("Type is not number");
+    uint64_t bits = rawBits();
+    if (tag() == 'l') return double(int64_t(bits));
+    if (tag() == 'u') return double(bits);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline int64_t JsonElement::getInt64() const {
+    if (!isInt64()) throw std::runtime_error("Type is not int64");
+    return int64_t(rawBits());
+}
+
+inline uint64_t JsonElement::getUint64() const {
+    if (!isUint64()) throw std::runtime_error("Type is not uint64");
+    return rawBits();
+}
+
+inline std::string_view JsonElement::getString() const {
+    if (!isString()) throw std::runtime_error("Type is not string");
+    if (tag() == 's') {
+        uint64_t payload = jsontape::payloadOf(doc->tape[i]);
+        return {doc->source->data() + (payload & 0xffffffff), payload >> 32};
+    }
+    const char* p = doc->strings.data() + jsontape::payloadOf(doc->tape[i]);
+    uint32_t length;
+    std::memcpy(&length, p, sizeof(length));
+    return {p + sizeof(length), length};
+}
+
+inline JsonArrayView JsonElement::getArray() const {
+    if (!isArray()) throw std::runtime_error("Type is not array");
+    return {doc, i};
+}
+
+inline JsonObjectView JsonElement::getObject() const {
+    if (!isObject()) throw std::runtime_error("Type is not object");
+    return {doc, i};
+}
+
+inline size_t JsonElement::after() const {
+    switch (tag()) {
+        case 'd': case 'l': case 'u': return i + 2;
+        case '[': case '{': return jsontape::payloadOf(doc->tape[i]) & 0xffffffff;
+        default: return i + 1;
+    }
+}
+
+inline JsonValue JsonElement::toValue() const {
+    switch (tag()) {
+        case 'n': return {nullptr};
+        case 't': return {true};
+        case 'f': return {false};
+        case 'd': return {getNumber()};
+        case 'l': return {getInt64()};
+        case 'u': return {getUint64()};
+        case '"': case 's': return {std::string(getString())};
+        case '[': {
+            JsonArray arr;
+            for (JsonElement e : getArray()) {
+                arr.push_back(e.toValue());
+            }
+            return {std::move(arr)};
+        }
+        case '{': {
+            JsonObject obj;
+            for (JsonObjectView::Member m : getObject()) {
+                obj[std::string(m.key)] = m.value.toValue();
+            }
+            return {std::move(obj)};
+        }
+        default: throw std::runtime_error("Invalid JsonValue.");
+    }
+}
+
+inline JsonArrayView::iterator JsonArrayView::begin() const { return {doc, open + 1}; }
+inline JsonArrayView::iterator JsonArrayView::end() const {
+    return {doc, JsonElement(doc, open).after() - 1};
+}
+inline size_t JsonArrayView::size() const {
+    uint64_t count = jsontape::payloadOf(doc->tape[open]) >> 32;
+    if (count < jsontape::COUNT_MAX) {
+        return count;
+    }
+    size_t n = 0;
+    for (iterator it = begin(); it != end(); ++it) { n++; }
+    return n;
+}
+inline JsonElement JsonArrayView::at(size_t n) const {
+    for (iterator it = begin(); it != end(); ++it) {
+        if (n-- == 0) {
+            return *it;
+        }
+    }
+    throw std::runtime_error("Array index out of range");
+}
+
+inline JsonObjectView::iterator JsonObjectView::begin() const { return {doc, open + 1}; }
+inline JsonObjectView::iterator JsonObjectView::end() const {
+    return {doc, JsonElement(doc, open).after() - 1};
+}
+inline size_t JsonObjectView::size() const {
+    uint64_t count = jsontape::payloadOf(doc->tape[open]) >> 32;
+    if (count < jsontape::COUNT_MAX) {
+        return count;
+    }
+    size_t n = 0;
+    for (iterator it = begin(); it != end(); ++it) { n++; }
+    return n;
+}
+inline JsonObjectView::iterator JsonObjectView::find(std::string_view key) const {
+    iterator it = begin();
+    for (; it != end(); ++it) {
+        if ((*it).key == key) {
+            break;
+        }
+    }
+    return it;
+}
+inline JsonElement JsonObjectView::at(std::string_view key) const {
+    iterator it = find(key);
+    if (it == end()) {
+        throw std::runtime_error("Key not found");
+    }
+    return (*it).value;
+}
+
+inline JsonElement JsonElement::operator[](std::string_view key) const {
+    return getObject().at(key);
+}
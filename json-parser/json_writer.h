@@ -0,0 +1,259 @@
+#pragma once
+
+#include "json_number.h"
+#include "json_string.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+
+// streaming serializer
+//
+// JsonWriter turns startObject/key/number/... calls (the same names as
+// JsonSaxHandler, so a writer can sit behind JsonStreamParser) into JSON
+// text, compact or pretty printed with one tab per level. output goes to a
+// sink with write(const char*, size_t) and put(char). the writer keeps no
+// stack, only the depth, and allocates nothing itself.
+
+// appends to a caller owned string, its capacity is reused across documents
+class StringSink {
+private:
+    std::string& out;
+
+public:
+    explicit StringSink(std::string& out) : out(out) {}
+    void write(const char* p, size_t n) { out.append(p, n); }
+    void put(char c) { out.push_back(c); }
+};
+
+// writes into a caller provided buffer, throws once it is full
+class FixedSink {
+private:
+    char* buffer;
+    size_t capacity;
+    size_t length = 0;
+
+public:
+    FixedSink(char* buffer, size_t capacity) : buffer(buffer), capacity(capacity) {}
+    void write(const char* p, size_t n) {
+        if (n > capacity - length) {
+            throw std::runtime_error("Output buffer full");
+        }
+        std::memcpy(buffer + length, p, n);
+        length += n;
+    }
+    void put(char c) { write(&c, 1); }
+    size_t size() const { return length; }
+    std::string_view view() const { return {buffer, length}; }
+};
+
+// buffers and writes to a file descriptor it does not own. call flush() at
+// the end to see write errors, the destructor flushes but cannot report
+class FdSink {
+private:
+    int fd;
+    std::unique_ptr<char[]> buffer;
+    size_t capacity;
+    size_t length = 0;
+
+    void drain(const char* p, size_t n) {
+        while (n > 0) {
+            ssize_t written = ::write(fd, p, n);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("Unable to write file");
+            }
+            p += written;
+            n -= written;
+        }
+    }
+
+public:
+    explicit FdSink(int fd, size_t bufferSize = 1 << 16)
+        : fd(fd), buffer(new char[bufferSize]), capacity(bufferSize) {}
+    FdSink(const FdSink&) = delete;
+    FdSink& operator=(const FdSink&) = delete;
+    ~FdSink() {
+        try {
+            flush();
+        } catch (const std::runtime_error&) {
+        }
+    }
+
+    void write(const char* p, size_t n) {
+        if (n > capacity - length) {
+            flush();
+            if (n >= capacity) {
+                drain(p, n); // large strings skip the buffer
+                return;
+            }
+        }
+        std::memcpy(buffer.get() + length, p, n);
+        length += n;
+    }
+    void put(char c) {
+        if (length == capacity) {
+            flush();
+        }
+        buffer[length++] = c;
+    }
+    void flush() {
+        size_t n = length;
+        length = 0;
+        drain(buffer.get(), n);
+    }
+};
+
+namespace jsonwriter {
+
+// 0 for bytes copied as is, otherwise the character after the backslash,
+// 'u' for control characters without a short escape
+inline constexpr char ESCAPE[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+};
+
+// writes s quoted, escaping quotes, backslashes and control characters.
+// runs of plain bytes are found 32 at a time and go to the sink in one call
+template <typename Sink>
+inline void writeString(Sink& sink, std::string_view s) {
+    sink.put('"');
+    const char* p = s.data();
+    const char* end = p + s.size();
+    while (p < end) {
+        const char* run = p;
+        p += jsonstr::escapeRun(p, end - p);
+        while (p < end && ESCAPE[static_cast<unsigned char>(*p)] == 0) {
+            p++;
+        }
+        if (p > run) {
+            sink.write(run, p - run);
+        }
+        if (p == end) {
+            break;
+        }
+        char e = ESCAPE[static_cast<unsigned char>(*p)];
+        if (e == 'u') {
+            static constexpr char hex[] = "0123456789abcdef";
+            unsigned char c = static_cast<unsigned char>(*p);
+            char u[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+            sink.write(u, 6);
+        } else {
+            char esc[2] = {'\\', e};
+            sink.write(esc, 2);
+        }
+        p++;
+    }
+    sink.put('"');
+}
+
+} // namespace jsonwriter
+
+template <typename Sink>
+class JsonWriter {
+private:
+    Sink& out;
+    bool pretty;
+    size_t depth = 0;
+    bool first = true;     // nothing written yet at this depth
+    bool afterKey = false; // a key was written, its value comes next
+
+    void newline() {
+        static constexpr char tabs[] = "\n\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+        constexpr size_t TABS = sizeof(tabs) - 2;
+        size_t n = depth;
+        out.write(tabs, std::min(n, TABS) + 1);
+        for (n -= std::min(n, TABS); n > 0; n -= std::min(n, TABS)) {
+            out.write(tabs + 1, std::min(n, TABS));
+        }
+    }
+
+    void beforeValue() {
+        if (afterKey) {
+            afterKey = false;
+            return;
+        }
+        if (depth > 0) {
+            if (!first) {
+                out.put(',');
+            }
+            if (pretty) {
+                newline();
+            }
+        }
+        first = false;
+    }
+
+    void open(char c) {
+        beforeValue();
+        out.put(c);
+        depth++;
+        first = true;
+    }
+
+    void close(char c) {
+        depth--;
+        if (pretty && !first) {
+            newline();
+        }
+        out.put(c);
+        first = false;
+    }
+
+    template <typename T>
+    void writeNumber(T v) {
+        beforeValue();
+        char buf[jsonnum::MAX_CHARS];
+        out.write(buf, jsonnum::format(v, buf) - buf);
+    }
+
+public:
+    explicit JsonWriter(Sink& sink, bool pretty = false) : out(sink), pretty(pretty) {}
+
+    void startObject() { open('{'); }
+    void endObject() { close('}'); }
+    void startArray() { open('['); }
+    void endArray() { close(']'); }
+    void key(std::string_view k) {
+        beforeValue();
+        jsonwriter::writeString(out, k);
+        if (pretty) {
+            out.write(": ", 2);
+        } else {
+            out.put(':');
+        }
+        afterKey = true;
+    }
+    void string(std::string_view s) {
+        beforeValue();
+        jsonwriter::writeString(out, s);
+    }
+    void number(double v) { writeNumber(v); }
+    void number(int64_t v) { writeNumber(v); }
+    void number(uint64_t v) { writeNumber(v); }
+    void boolean(bool v) {
+        beforeValue();
+        if (v) {
+            out.write("true", 4);
+        } else {
+            out.write("false", 5);
+        }
+    }
+    void null() {
+        beforeValue();
+        out.write("null", 4);
+    }
+
+    Sink& sink() { return out; }
+};
@@ -1,14 +1,31 @@
 #include "json.h"
+#include "json_bind.h"
 #include <string>
 
+struct WindowPosition {
+    int x = 0;
+    int y = 0;
+};
+
 struct Settings {
+    int fontSize = 0;
+    int textBufferLength = 0;
+    int inactiveTimeout = 0;
+    double transparency = 1;
+    std::string textColor;
+    std::string backgroundColor;
+    WindowPosition windowPosition;
 };
 
+JSON_BIND(WindowPosition, x, y)
+JSON_BIND(Settings, fontSize, textBufferLength, inactiveTimeout, transparency, textColor, backgroundColor, windowPosition)
+
 int main() {
     Json j = Json();
     std::string path = "test.json";
     JsonValue res = j.parseFromFile(path);
     std::string jsonStr = j.stringify(res);
     j.writeToFile("res.json", jsonStr);
-    return 0;
+    Settings settings = jsonbind::parseFromFile<Settings>(path);
+    return settings.fontSize > 0 ? 0 : 1;
 }